@@ -30,6 +30,11 @@ export const useFunctions = () => {
     'clearPresses',
   );
 
+  const setTimezone = httpsCallable<
+    { timezone: string; timezoneName: string },
+    { success: boolean; message: string }
+  >(functions, 'setTimezone');
+
   const deleteAccount = httpsCallable<void, { success: boolean; message: string }>(
     functions,
     'deleteAccount',
@@ -40,6 +45,7 @@ export const useFunctions = () => {
     claimDevice,
     unlinkDevice,
     clearPresses,
+    setTimezone,
     deleteAccount,
   };
 };
@@ -0,0 +1,127 @@
+const DAY_MS = 86400000;
+const HOUR_MS = 3600000;
+const MINUTE_MS = 60000;
+
+interface Transition {
+  at: number; // first UTC ms with the new offset
+  before: number; // offsets in minutes east of UTC
+  after: number;
+}
+
+type OffsetAt = (at: number) => number;
+
+// One formatter per zone; creating them dominates the cost otherwise
+function offsetFunction(timeZone: string): OffsetAt {
+  const format = new Intl.DateTimeFormat("en-US", {
+    timeZone,
+    timeZoneName: "longOffset",
+  });
+  return (at) => {
+    const name = format
+      .formatToParts(new Date(at))
+      .find((part) => part.type === "timeZoneName")?.value;
+    // "GMT-07:00", or plain "GMT" for UTC itself
+    const match = name?.match(/^GMT([+-])(\d{2}):(\d{2})$/);
+    if (!match) return 0;
+    const minutes = Number(match[2]) * 60 + Number(match[3]);
+    return match[1] === "-" ? -minutes : minutes;
+  };
+}
+
+// Alphabetic abbreviation when a locale has one ("MST", "CET"), otherwise
+// the numeric form tzdata uses ("<+0530>")
+function zoneName(timeZone: string, at: number, offset: number): string {
+  for (const locale of ["en-US", "en-GB"]) {
+    const name = new Intl.DateTimeFormat(locale, {
+      timeZone,
+      timeZoneName: "short",
+    })
+      .formatToParts(new Date(at))
+      .find((part) => part.type === "timeZoneName")?.value;
+    if (name && /^[A-Za-z]{3,6}$/.test(name)) return name;
+  }
+
+  const abs = Math.abs(offset);
+  const hours = String(Math.floor(abs / 60)).padStart(2, "0");
+  const minutes = abs % 60 ? String(abs % 60).padStart(2, "0") : "";
+  return `<${offset < 0 ? "-" : "+"}${hours}${minutes}>`;
+}
+
+// POSIX offsets count hours west of UTC
+function posixOffset(offset: number): string {
+  const west = -offset;
+  const abs = Math.abs(west);
+  const minutes = abs % 60 ? `:${String(abs % 60).padStart(2, "0")}` : "";
+  return `${west < 0 ? "-" : ""}${Math.floor(abs / 60)}${minutes}`;
+}
+
+// "Mm.w.d/time": the w-th weekday d of month m (5 = last), at the local
+// time in effect just before the change
+function posixRule(transition: Transition): string {
+  const local = new Date(transition.at + transition.before * MINUTE_MS);
+  const year = local.getUTCFullYear();
+  const month = local.getUTCMonth() + 1;
+  const day = local.getUTCDate();
+  const daysInMonth = new Date(Date.UTC(year, month, 0)).getUTCDate();
+  const week = day + 7 > daysInMonth ? 5 : Math.ceil(day / 7);
+  const minutes = local.getUTCMinutes();
+  const time = `${local.getUTCHours()}${
+    minutes ? `:${String(minutes).padStart(2, "0")}` : ""
+  }`;
+  return `M${month}.${week}.${local.getUTCDay()}/${time}`;
+}
+
+// Scan the year a day at a time, then narrow each change down to the minute
+function findTransitions(offsetAt: OffsetAt, year: number): Transition[] {
+  const transitions: Transition[] = [];
+  const end = Date.UTC(year + 1, 0, 1);
+  for (let t = Date.UTC(year, 0, 1); t < end; t += DAY_MS) {
+    const before = offsetAt(t);
+    if (offsetAt(t + DAY_MS) === before) continue;
+
+    let lo = t;
+    let hi = t + DAY_MS;
+    while (hi - lo > MINUTE_MS) {
+      const mid = lo + Math.floor((hi - lo) / MINUTE_MS / 2) * MINUTE_MS;
+      if (offsetAt(mid) === before) lo = mid;
+      else hi = mid;
+    }
+    transitions.push({ at: hi, before, after: offsetAt(hi) });
+  }
+  return transitions;
+}
+
+/**
+ * Convert an IANA time zone to the POSIX TZ rule the device uses, e.g.
+ * "America/Denver" -> "MST7MDT,M3.2.0/2,M11.1.0/2".
+ *
+ * The rule is derived from the zone's offsets and DST transitions in the
+ * given year, so it is only as good as that year's rules are for the next.
+ */
+export function posixTimezone(
+  timeZone: string = Intl.DateTimeFormat().resolvedOptions().timeZone,
+  year: number = new Date().getFullYear()
+): string {
+  const offsetAt = offsetFunction(timeZone);
+  const transitions = findTransitions(offsetAt, year);
+  const toDst = transitions.find((t) => t.after > t.before);
+  const toStd = transitions.find((t) => t.after < t.before);
+
+  if (transitions.length !== 2 || !toDst || !toStd) {
+    // No DST (or a one-off change this year): keep the offset in effect now
+    const now = Math.min(Date.now(), Date.UTC(year + 1, 0, 1) - 1);
+    const offset = offsetAt(now);
+    return `${zoneName(timeZone, now, offset)}${posixOffset(offset)}`;
+  }
+
+  const std = toDst.before;
+  const dst = toDst.after;
+  const stdName = zoneName(timeZone, toDst.at - HOUR_MS, std);
+  const dstName = zoneName(timeZone, toDst.at, dst);
+  // The DST offset may be omitted when it is the usual one hour ahead
+  const dstOffset = dst - std === 60 ? "" : posixOffset(dst);
+  return (
+    `${stdName}${posixOffset(std)}${dstName}${dstOffset},` +
+    `${posixRule(toDst)},${posixRule(toStd)}`
+  );
+}
@@ -0,0 +1,175 @@
+// Load test for buttonPress vs buttonPressBatch against the Firebase emulator.
+//
+// Usage (from client/):
+//   firebase emulators:start --only functions,firestore
+//   npm --prefix functions run loadtest
+//
+// Seeds DEVICES fake devices, has each one upload PRESSES presses through
+// both endpoints and prints request counts and latency. If the emulator has
+// HMAC_SECRET set (functions/.secret.local), pass the same value here so the
+// requests are signed.
+//
+// Environment:
+//   DEVICES       number of simulated devices (default 10)
+//   PRESSES       presses uploaded per device (default 50)
+//   BATCH_SIZE    presses per buttonPressBatch request (default 32)
+//   HMAC_SECRET   hex key used to sign requests (default: unsigned)
+//   FUNCTIONS_URL (default http://127.0.0.1:5001/pressit-today/us-central1)
+
+import crypto from "node:crypto";
+import { initializeApp } from "firebase-admin/app";
+import { getFirestore } from "firebase-admin/firestore";
+
+const DEVICES = Number(process.env.DEVICES ?? 10);
+const PRESSES = Number(process.env.PRESSES ?? 50);
+const BATCH_SIZE = Number(process.env.BATCH_SIZE ?? 32);
+const HMAC_SECRET = process.env.HMAC_SECRET ?? "";
+const FUNCTIONS_URL =
+  process.env.FUNCTIONS_URL ??
+  "http://127.0.0.1:5001/pressit-today/us-central1";
+
+process.env.FIRESTORE_EMULATOR_HOST ??= "127.0.0.1:8081";
+
+initializeApp({ projectId: "pressit-today" });
+const db = getFirestore();
+
+function deviceMac(index) {
+  const hex = index.toString(16).padStart(4, "0").toUpperCase();
+  return `02:4C:54:00:${hex.slice(0, 2)}:${hex.slice(2)}`;
+}
+
+function deviceId(index) {
+  return `loadtest-${index}`;
+}
+
+// One press per day going back from today, so every press is a distinct doc
+function pressDates(count) {
+  const dates = [];
+  const day = new Date();
+  for (let i = 0; i < count; i++) {
+    dates.push(day.toISOString().slice(0, 10));
+    day.setUTCDate(day.getUTCDate() - 1);
+  }
+  return dates;
+}
+
+async function post(endpoint, payload) {
+  const body = JSON.stringify(payload);
+  const headers = { "Content-Type": "application/json" };
+  if (HMAC_SECRET) {
+    headers["X-HMAC-Signature"] = crypto
+      .createHmac("sha256", Buffer.from(HMAC_SECRET, "hex"))
+      .update(body)
+      .digest("hex");
+  }
+
+  const start = performance.now();
+  const res = await fetch(`${FUNCTIONS_URL}/${endpoint}`, {
+    method: "POST",
+    headers,
+    body,
+  });
+  const json = await res.json().catch(() => ({}));
+  return { status: res.status, json, ms: performance.now() - start };
+}
+
+async function seedDevices() {
+  for (let i = 0; i < DEVICES; i++) {
+    const ref = db.collection("devices").doc(deviceId(i));
+    await db.recursiveDelete(ref);
+    await ref.set({ macAddress: deviceMac(i), claimCode: `LOADTEST${i}` });
+  }
+}
+
+async function clearPresses() {
+  for (let i = 0; i < DEVICES; i++) {
+    await db.recursiveDelete(
+      db.collection("devices").doc(deviceId(i)).collection("presses")
+    );
+  }
+}
+
+async function countPresses() {
+  let total = 0;
+  for (let i = 0; i < DEVICES; i++) {
+    const snapshot = await db
+      .collection("devices")
+      .doc(deviceId(i))
+      .collection("presses")
+      .count()
+      .get();
+    total += snapshot.data().count;
+  }
+  return total;
+}
+
+async function runSingle(index, dates, stats) {
+  for (const date of dates) {
+    const { status, ms } = await post("buttonPress", {
+      mac: deviceMac(index),
+      state: true,
+      date,
+      timestamp: Math.floor(Date.now() / 1000),
+    });
+    stats.latencies.push(ms);
+    if (status !== 200) stats.failures++;
+  }
+}
+
+async function runBatch(index, dates, stats) {
+  for (let i = 0; i < dates.length; i += BATCH_SIZE) {
+    const events = dates
+      .slice(i, i + BATCH_SIZE)
+      .map((date, j) => ({ seq: i + j + 1, state: true, date }));
+    const { status, json, ms } = await post("buttonPressBatch", {
+      mac: deviceMac(index),
+      timestamp: Math.floor(Date.now() / 1000),
+      events,
+    });
+    stats.latencies.push(ms);
+    if (status !== 200) {
+      stats.failures += events.length;
+    } else {
+      stats.failures += json.results.filter((r) => !r.ok).length;
+    }
+  }
+}
+
+function percentile(sorted, p) {
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+async function runScenario(name, run) {
+  await clearPresses();
+  const dates = pressDates(PRESSES);
+  const stats = { latencies: [], failures: 0 };
+
+  const start = performance.now();
+  await Promise.all(
+    Array.from({ length: DEVICES }, (_, i) => run(i, dates, stats))
+  );
+  const elapsed = performance.now() - start;
+
+  const sorted = [...stats.latencies].sort((a, b) => a - b);
+  const stored = await countPresses();
+  console.log(
+    `${name.padEnd(16)} ${String(sorted.length).padStart(6)} requests  ` +
+      `${(elapsed / 1000).toFixed(2).padStart(7)} s  ` +
+      `p50 ${percentile(sorted, 0.5).toFixed(0).padStart(5)} ms  ` +
+      `p95 ${percentile(sorted, 0.95).toFixed(0).padStart(5)} ms  ` +
+      `failed ${stats.failures}  stored ${stored}/${DEVICES * PRESSES}`
+  );
+}
+
+console.log(
+  `${DEVICES} devices x ${PRESSES} presses, batch size ${BATCH_SIZE}, ` +
+    `${HMAC_SECRET ? "signed" : "unsigned"} requests to ${FUNCTIONS_URL}`
+);
+
+await seedDevices();
+await runScenario("buttonPress", runSingle);
+await runScenario("buttonPressBatch", runBatch);
+
+for (let i = 0; i < DEVICES; i++) {
+  await db.recursiveDelete(db.collection("devices").doc(deviceId(i)));
+}
@@ -100,6 +100,7 @@ interface ButtonPressData {
   state: boolean;
   date: string; // YYYY-MM-DD in device's local time
   timestamp: number; // Unix timestamp for replay protection
+  seq?: number; // Device journal sequence number, if the press was journaled
 }
 
 // Maximum allowed time difference for replay protection (5 minutes)
@@ -132,10 +133,120 @@ function verifyHmacSignature(
   }
 }
 
+/**
+ * Checks shared by every device request: POST only, a valid HMAC signature
+ * and a fresh timestamp (if HMAC_SECRET is configured).
+ * Sends the error response and returns false if the request is refused.
+ */
+function verifyDeviceRequest(req: Request, res: Response): boolean {
+  // Only allow POST requests
+  if (req.method !== "POST") {
+    res.status(405).json({ error: "Method not allowed" });
+    return false;
+  }
+
+  // Get raw body for signature verification
+  const rawBody =
+    typeof req.body === "string" ? req.body : JSON.stringify(req.body);
+
+  // Verify HMAC signature if secret is configured
+  const secret = hmacSecret.value();
+  if (!secret) {
+    return true;
+  }
+
+  const signature = req.get("X-HMAC-Signature");
+
+  if (!signature) {
+    res.status(401).json({ error: "Missing HMAC signature" });
+    return false;
+  }
+
+  if (!verifyHmacSignature(rawBody, signature, secret)) {
+    res.status(401).json({ error: "Invalid HMAC signature" });
+    return false;
+  }
+
+  // Validate timestamp for replay protection
+  const { timestamp } = req.body as { timestamp?: unknown };
+  if (!timestamp || typeof timestamp !== "number") {
+    res.status(400).json({ error: "Timestamp is required" });
+    return false;
+  }
+
+  const now = Math.floor(Date.now() / 1000);
+  const drift = Math.abs(now - timestamp);
+
+  if (drift > MAX_TIMESTAMP_DRIFT_SECONDS) {
+    res.status(401).json({
+      error: "Request expired",
+      serverTime: now,
+      requestTime: timestamp,
+    });
+    return false;
+  }
+
+  return true;
+}
+
+function isValidDate(date: unknown): date is string {
+  return typeof date === "string" && /^\d{4}-\d{2}-\d{2}$/.test(date);
+}
+
+interface DeviceInfo {
+  id: string;
+  timezone?: string; // POSIX TZ rule set from the web app
+  stateSeq: number; // Highest device journal seq applied, 0 if none
+}
+
+/**
+ * Look up a device by MAC address.
+ */
+async function findDeviceByMac(mac: string): Promise<DeviceInfo | null> {
+  const normalizedMac = mac.toUpperCase().trim();
+
+  const snapshot = await db
+    .collection("devices")
+    .where("macAddress", "==", normalizedMac)
+    .limit(1)
+    .get();
+
+  if (snapshot.empty) {
+    return null;
+  }
+  const doc = snapshot.docs[0];
+  const timezone = doc.get("timezone");
+  const stateSeq = doc.get("stateSeq");
+  const device: DeviceInfo = {
+    id: doc.id,
+    stateSeq: Number.isInteger(stateSeq) ? stateSeq : 0,
+  };
+  if (typeof timezone === "string") {
+    device.timezone = timezone;
+  }
+  return device;
+}
+
+/**
+ * Fields every device response carries, so a time zone changed in the web
+ * app reaches the device with its next press.
+ */
+function deviceResponseFields(device: DeviceInfo) {
+  return device.timezone ? { timezone: device.timezone } : {};
+}
+
+function pressRef(deviceId: string, date: string) {
+  return db
+    .collection("devices")
+    .doc(deviceId)
+    .collection("presses")
+    .doc(date);
+}
+
 /**
  * HTTP endpoint to receive button presses from devices.
  *
- * Expected input: { mac: "AA:BB:CC:DD:EE:FF", state: true, date: "2025-01-15", timestamp: 1234567890 }
+ * Expected input: { mac: "AA:BB:CC:DD:EE:FF", state: true, date: "2025-01-15", timestamp: 1234567890, seq?: 12 }
  * Header: X-HMAC-Signature: <hex-encoded HMAC-SHA256 of request body>
  *
  * This function:
@@ -145,117 +256,396 @@ function verifyHmacSignature(
  * 4. Looks up the device by MAC address
  * 5. If state is true: saves the button press timestamp to device subcollection
  * 6. If state is false: deletes the button press for that date
+ * 7. Records seq in the device's stateSeq, like buttonPressBatch, in the
+ *    same Firestore batch as the press
  *
  * Presses are stored on the device, allowing tracking before the device is claimed.
+ * The response includes the device's time zone rule, if one has been set.
  */
 export const buttonPress = onRequest(
   { secrets: [hmacSecret] },
   async (req: Request, res: Response) => {
-    // Only allow POST requests
-    if (req.method !== "POST") {
-      res.status(405).json({ error: "Method not allowed" });
+    if (!verifyDeviceRequest(req, res)) {
       return;
     }
 
-    // Get raw body for signature verification
-    const rawBody =
-      typeof req.body === "string" ? req.body : JSON.stringify(req.body);
+    const { mac, state, date, seq } = req.body as ButtonPressData;
 
-    // Verify HMAC signature if secret is configured
-    const secret = hmacSecret.value();
-    if (secret) {
-      const signature = req.get("X-HMAC-Signature");
+    // Validate input
+    if (!mac || typeof mac !== "string") {
+      res.status(400).json({ error: "MAC address is required" });
+      return;
+    }
 
-      if (!signature) {
-        res.status(401).json({ error: "Missing HMAC signature" });
-        return;
-      }
+    if (typeof state !== "boolean") {
+      res.status(400).json({ error: "State must be a boolean" });
+      return;
+    }
 
-      if (!verifyHmacSignature(rawBody, signature, secret)) {
-        res.status(401).json({ error: "Invalid HMAC signature" });
-        return;
-      }
+    if (!isValidDate(date)) {
+      res.status(400).json({ error: "Date must be in YYYY-MM-DD format" });
+      return;
     }
 
-    const { mac, state, date, timestamp } = req.body as ButtonPressData;
+    if (seq !== undefined && !(Number.isInteger(seq) && seq >= 0)) {
+      res.status(400).json({ error: "Seq must be a non-negative integer" });
+      return;
+    }
 
-    // Validate timestamp for replay protection (only if HMAC is enabled)
-    if (secret) {
-      if (!timestamp || typeof timestamp !== "number") {
-        res.status(400).json({ error: "Timestamp is required" });
-        return;
-      }
+    // Look up the device by MAC address
+    const device = await findDeviceByMac(mac);
 
-      const now = Math.floor(Date.now() / 1000);
-      const drift = Math.abs(now - timestamp);
+    if (!device) {
+      res.status(404).json({ error: "Device not found" });
+      return;
+    }
 
-      if (drift > MAX_TIMESTAMP_DRIFT_SECONDS) {
-        res.status(401).json({
-          error: "Request expired",
-          serverTime: now,
-          requestTime: timestamp,
-        });
-        return;
-      }
+    // Write press to device subcollection (works even before device is claimed)
+    const ref = pressRef(device.id, date);
+    const batch = db.batch();
+
+    if (seq !== undefined && seq > device.stateSeq) {
+      batch.update(db.collection("devices").doc(device.id), {
+        stateSeq: seq,
+      });
+    }
+
+    if (state) {
+      // Save the button press
+      batch.set(ref, {
+        date,
+        pressedAt: admin.firestore.FieldValue.serverTimestamp(),
+      });
+    } else {
+      // Delete the button press
+      batch.delete(ref);
+    }
+    await batch.commit();
+
+    res.status(200).json({
+      success: true,
+      message: state ? "Press recorded" : "Press deleted",
+      ...deviceResponseFields(device),
+    });
+  }
+);
+
+interface PressEvent {
+  seq: number; // Device journal sequence number
+  state: boolean;
+  date: string; // YYYY-MM-DD in device's local time
+}
+
+interface ButtonPressBatchData {
+  mac: string;
+  timestamp: number; // Unix timestamp for replay protection
+  events: PressEvent[];
+}
+
+interface PressEventResult {
+  seq: number;
+  ok: boolean;
+  error?: string;
+}
+
+// Well under the 500 write limit of a Firestore batch
+const MAX_BATCH_EVENTS = 100;
+
+function validatePressEvent(event: PressEvent): string | null {
+  if (typeof event?.state !== "boolean") {
+    return "State must be a boolean";
+  }
+  if (!isValidDate(event.date)) {
+    return "Date must be in YYYY-MM-DD format";
+  }
+  return null;
+}
+
+/**
+ * HTTP endpoint to receive several button presses in one request, used by
+ * devices replaying presses recorded while offline.
+ *
+ * Expected input: {
+ *   mac: "AA:BB:CC:DD:EE:FF",
+ *   timestamp: 1234567890,
+ *   events: [{ seq: 1, state: true, date: "2025-01-15" }, ...]
+ * }
+ * Header: X-HMAC-Signature: <hex-encoded HMAC-SHA256 of request body>
+ *
+ * This function:
+ * 1. Verifies the request the same way as buttonPress
+ * 2. Looks up the device by MAC address once
+ * 3. Validates each event; invalid events are reported and skipped
+ * 4. Applies the valid events in seq order in a single Firestore batch,
+ *    so only the last state for each date is written
+ * 5. Records the highest seq in the device's stateSeq, which deviceState
+ *    reports back so the device can tell whose state is newer
+ *
+ * Response: { success: true, timezone?, results: [{ seq: 1, ok: true }, ...] }
+ * with one result per event, in request order.
+ */
+export const buttonPressBatch = onRequest(
+  { secrets: [hmacSecret] },
+  async (req: Request, res: Response) => {
+    if (!verifyDeviceRequest(req, res)) {
+      return;
     }
 
+    const { mac, events } = req.body as ButtonPressBatchData;
+
     // Validate input
     if (!mac || typeof mac !== "string") {
       res.status(400).json({ error: "MAC address is required" });
       return;
     }
 
-    if (typeof state !== "boolean") {
-      res.status(400).json({ error: "State must be a boolean" });
+    if (!Array.isArray(events) || events.length === 0) {
+      res.status(400).json({ error: "Events must be a non-empty array" });
+      return;
+    }
+
+    if (events.length > MAX_BATCH_EVENTS) {
+      res.status(400).json({
+        error: `At most ${MAX_BATCH_EVENTS} events per request`,
+      });
       return;
     }
 
     if (
-      !date ||
-      typeof date !== "string" ||
-      !/^\d{4}-\d{2}-\d{2}$/.test(date)
+      !events.every((event) => Number.isInteger(event?.seq) && event.seq >= 0)
     ) {
-      res.status(400).json({ error: "Date must be in YYYY-MM-DD format" });
+      res.status(400).json({ error: "Every event needs a seq number" });
       return;
     }
 
-    const normalizedMac = mac.toUpperCase().trim();
-
     // Look up the device by MAC address
-    const devicesRef = db.collection("devices");
-    const snapshot = await devicesRef
-      .where("macAddress", "==", normalizedMac)
-      .limit(1)
-      .get();
+    const device = await findDeviceByMac(mac);
 
-    if (snapshot.empty) {
+    if (!device) {
       res.status(404).json({ error: "Device not found" });
       return;
     }
 
-    const deviceDoc = snapshot.docs[0];
+    const results: PressEventResult[] = events.map((event) => {
+      const error = validatePressEvent(event);
+      return error
+        ? { seq: event.seq, ok: false, error }
+        : { seq: event.seq, ok: true };
+    });
 
-    // Write press to device subcollection (works even before device is claimed)
-    const pressRef = db
+    // Later events for the same date override earlier ones
+    const finalState = new Map<string, boolean>();
+    events
+      .filter((_, i) => results[i].ok)
+      .sort((a, b) => a.seq - b.seq)
+      .forEach((event) => finalState.set(event.date, event.state));
+
+    const batch = db.batch();
+
+    // Rejected events are consumed too: the device acks the whole batch
+    const maxSeq = Math.max(...events.map((event) => event.seq));
+    if (maxSeq > device.stateSeq) {
+      batch.update(db.collection("devices").doc(device.id), {
+        stateSeq: maxSeq,
+      });
+    }
+
+    for (const [date, state] of finalState) {
+      if (state) {
+        batch.set(pressRef(device.id, date), {
+          date,
+          pressedAt: admin.firestore.FieldValue.serverTimestamp(),
+        });
+      } else {
+        batch.delete(pressRef(device.id, date));
+      }
+    }
+    await batch.commit();
+
+    // The time zone goes before the results, which the device may truncate
+    res.status(200).json({
+      success: true,
+      ...deviceResponseFields(device),
+      results,
+    });
+  }
+);
+
+interface DeviceStateData {
+  mac: string;
+  timestamp: number; // Unix timestamp for replay protection
+  date: string; // YYYY-MM-DD, the device's current local date
+  days?: number; // How many days back from date to report
+}
+
+const DAY_MS = 86400000;
+const DEFAULT_STATE_DAYS = 32;
+// Matches the device's on-board history
+const MAX_STATE_DAYS = 384;
+
+/**
+ * Pressed days as a hex bitmap: bit (n % 8) of byte n / 8 is set when the
+ * day n days before end was pressed. The device stores its history in the
+ * same order.
+ */
+function pressBitmap(end: string, days: number, pressed: Set<string>) {
+  const bytes = Buffer.alloc(Math.ceil(days / 8));
+  const endMs = Date.parse(`${end}T00:00:00Z`);
+  for (let n = 0; n < days; n++) {
+    const date = new Date(endMs - n * DAY_MS).toISOString().slice(0, 10);
+    if (pressed.has(date)) {
+      bytes[n >> 3] |= 1 << (n & 7);
+    }
+  }
+  return bytes.toString("hex");
+}
+
+/**
+ * HTTP endpoint returning a device's recorded presses, so the device can
+ * correct its LEDs when they have drifted from Firestore.
+ *
+ * Expected input: {
+ *   mac: "AA:BB:CC:DD:EE:FF",
+ *   timestamp: 1234567890,
+ *   date: "2025-01-15",
+ *   days: 32
+ * }
+ * Header: X-HMAC-Signature: <hex-encoded HMAC-SHA256 of request body>
+ *
+ * Response: {
+ *   success: true, timezone?, date: "2025-01-15", days: 32,
+ *   seq: 120, bits: "05000000"
+ * }
+ * bits is the pressBitmap() of the days up to and including date. seq is
+ * the highest journal seq of the device that has been applied. A device
+ * that has acked presses beyond it knows Firestore missed a write and
+ * uploads its own state; otherwise it takes this one.
+ */
+export const deviceState = onRequest(
+  { secrets: [hmacSecret] },
+  async (req: Request, res: Response) => {
+    if (!verifyDeviceRequest(req, res)) {
+      return;
+    }
+
+    const { mac, date, days = DEFAULT_STATE_DAYS } =
+      req.body as DeviceStateData;
+
+    if (!mac || typeof mac !== "string") {
+      res.status(400).json({ error: "MAC address is required" });
+      return;
+    }
+
+    if (!isValidDate(date)) {
+      res.status(400).json({ error: "Date must be in YYYY-MM-DD format" });
+      return;
+    }
+
+    if (!Number.isInteger(days) || days < 1 || days > MAX_STATE_DAYS) {
+      res.status(400).json({
+        error: `Days must be between 1 and ${MAX_STATE_DAYS}`,
+      });
+      return;
+    }
+
+    const device = await findDeviceByMac(mac);
+
+    if (!device) {
+      res.status(404).json({ error: "Device not found" });
+      return;
+    }
+
+    const endMs = Date.parse(`${date}T00:00:00Z`);
+    const start = new Date(endMs - (days - 1) * DAY_MS)
+      .toISOString()
+      .slice(0, 10);
+    const snapshot = await db
       .collection("devices")
-      .doc(deviceDoc.id)
+      .doc(device.id)
       .collection("presses")
-      .doc(date);
+      .where("date", ">=", start)
+      .where("date", "<=", date)
+      .get();
+    const pressed = new Set(snapshot.docs.map((doc) => doc.get("date")));
 
-    if (state) {
-      // Save the button press
-      await pressRef.set({
-        date,
-        pressedAt: admin.firestore.FieldValue.serverTimestamp(),
-      });
+    res.status(200).json({
+      success: true,
+      ...deviceResponseFields(device),
+      date,
+      days,
+      seq: device.stateSeq,
+      bits: pressBitmap(date, days, pressed),
+    });
+  }
+);
 
-      res.status(200).json({ success: true, message: "Press recorded" });
-    } else {
-      // Delete the button press
-      await pressRef.delete();
+interface SetTimezoneData {
+  timezone: string; // POSIX TZ rule, e.g. "MST7MDT,M3.2.0/2,M11.1.0/2"
+  timezoneName?: string; // IANA zone it was derived from, for display
+}
+
+// Fits the device's 64-byte buffer
+const MAX_TIMEZONE_LENGTH = 63;
+
+// std name and offset, then optionally a DST name, offset and rules
+const POSIX_TZ_NAME = "(?:<[-+0-9A-Za-z]{1,10}>|[A-Za-z]{3,10})";
+const POSIX_TZ_OFFSET = "[-+]?\\d{1,2}(?::\\d{2}){0,2}";
+const POSIX_TZ_RULE = `(?:M\\d{1,2}\\.[1-5]\\.[0-6]|J?\\d{1,3})(?:/${POSIX_TZ_OFFSET})?`;
+const POSIX_TZ_PATTERN = new RegExp(
+  `^${POSIX_TZ_NAME}${POSIX_TZ_OFFSET}` +
+    `(?:${POSIX_TZ_NAME}(?:${POSIX_TZ_OFFSET})?` +
+    `(?:,${POSIX_TZ_RULE},${POSIX_TZ_RULE})?)?$`
+);
 
-      res.status(200).json({ success: true, message: "Press deleted" });
+/**
+ * Cloud function to set the time zone of a user's linked device.
+ *
+ * Expected input: { timezone: "MST7MDT,M3.2.0/2,M11.1.0/2", timezoneName: "America/Denver" }
+ *
+ * This function:
+ * 1. Verifies the user is authenticated
+ * 2. Validates the POSIX TZ rule
+ * 3. Stores it on the linked device; the device picks it up from the
+ *    response to its next press
+ */
+export const setTimezone = onCall(
+  async (request: CallableRequest<SetTimezoneData>) => {
+    if (!request.auth) {
+      throw new HttpsError(
+        "unauthenticated",
+        "Must be logged in to set the time zone"
+      );
     }
+
+    const { timezone, timezoneName } = request.data ?? {};
+    if (
+      typeof timezone !== "string" ||
+      timezone.length > MAX_TIMEZONE_LENGTH ||
+      !POSIX_TZ_PATTERN.test(timezone)
+    ) {
+      throw new HttpsError("invalid-argument", "Invalid time zone rule");
+    }
+
+    const userDoc = await db.collection("users").doc(request.auth.uid).get();
+    const deviceId = userDoc.data()?.deviceId;
+
+    if (!deviceId) {
+      throw new HttpsError("failed-precondition", "No device linked");
+    }
+
+    await db
+      .collection("devices")
+      .doc(deviceId)
+      .update({
+        timezone,
+        timezoneName:
+          typeof timezoneName === "string" ? timezoneName.slice(0, 64) : null,
+      });
+
+    return {
+      success: true,
+      message: "Time zone updated",
+    };
   }
 );
 
@@ -0,0 +1,49 @@
+import { describe, it, expect } from "vitest";
+import { posixTimezone } from "~/utils/posixTimezone";
+
+describe("posixTimezone", () => {
+  it("converts a northern hemisphere zone with DST", () => {
+    expect(posixTimezone("America/Denver", 2026)).toBe(
+      "MST7MDT,M3.2.0/2,M11.1.0/2"
+    );
+  });
+
+  it("uses 'last weekday of the month' for EU transitions", () => {
+    expect(posixTimezone("Europe/Berlin", 2026)).toBe(
+      "CET-1CEST,M3.5.0/2,M10.5.0/3"
+    );
+    expect(posixTimezone("Europe/London", 2026)).toBe(
+      "GMT0BST,M3.5.0/1,M10.5.0/2"
+    );
+  });
+
+  it("handles southern hemisphere DST spanning the new year", () => {
+    expect(posixTimezone("Australia/Sydney", 2026)).toMatch(
+      /^\S+-10\S+,M10\.1\.0\/2,M4\.1\.0\/3$/
+    );
+  });
+
+  it("keeps fractional offsets and non-hour DST shifts", () => {
+    expect(posixTimezone("Asia/Kolkata", 2026)).toMatch(/-5:30$/);
+    expect(posixTimezone("America/St_Johns", 2026)).toMatch(
+      /^\S+3:30\S+,M3\.2\.0\/2,M11\.1\.0\/2$/
+    );
+    // Lord Howe Island moves by 30 minutes, so the DST offset is explicit
+    expect(posixTimezone("Australia/Lord_Howe", 2026)).toMatch(
+      /^\S+-10:30\S+-11,M10\.1\.0\/2,M4\.1\.0\/2$/
+    );
+  });
+
+  it("returns a fixed offset for zones without DST", () => {
+    expect(posixTimezone("UTC", 2026)).toBe("UTC0");
+    expect(posixTimezone("America/Sao_Paulo", 2026)).toMatch(/^\S+3$/);
+  });
+
+  it("never produces names the device can't parse", () => {
+    for (const zone of ["Asia/Kolkata", "Pacific/Chatham", "Asia/Tehran"]) {
+      const rule = posixTimezone(zone, 2026);
+      const name = rule.match(/^(<[-+0-9]+>|[A-Za-z]{3,})/)?.[0];
+      expect(name, rule).toBeDefined();
+    }
+  });
+});
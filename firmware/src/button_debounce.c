@@ -0,0 +1,71 @@
+#include "button_debounce.h"
+
+static button_event_t accept_level(button_debounce_t *db, int level, int64_t time_us) {
+    db->stable_level = level;
+    if (level == db->active_level) {
+        db->pressed_at_us = time_us;
+        return BUTTON_EVENT_PRESS;
+    }
+    return BUTTON_EVENT_RELEASE;
+}
+
+void button_debounce_init(button_debounce_t *db, int active_level, int64_t settle_us) {
+    db->active_level = active_level;
+    db->settle_us = settle_us;
+    db->stable_level = !active_level;
+    db->raw_level = !active_level;
+    db->last_edge_us = 0;
+    db->lockout_until_us = BUTTON_DEBOUNCE_NO_DEADLINE;
+    db->pressed_at_us = 0;
+}
+
+button_event_t button_debounce_edge(button_debounce_t *db, int level, int64_t time_us) {
+    level = level ? 1 : 0;
+    db->raw_level = level;
+    db->last_edge_us = time_us;
+
+    if (db->lockout_until_us != BUTTON_DEBOUNCE_NO_DEADLINE) {
+        // Still bouncing - push the window out and decide once it is quiet
+        db->lockout_until_us = time_us + db->settle_us;
+        return BUTTON_EVENT_NONE;
+    }
+
+    if (level == db->stable_level) {
+        // The ISR sampled the pin after it had already bounced back
+        db->lockout_until_us = time_us + db->settle_us;
+        return BUTTON_EVENT_NONE;
+    }
+
+    db->lockout_until_us = time_us + db->settle_us;
+    return accept_level(db, level, time_us);
+}
+
+button_event_t button_debounce_poll(button_debounce_t *db, int64_t now_us) {
+    if (db->lockout_until_us == BUTTON_DEBOUNCE_NO_DEADLINE || now_us < db->lockout_until_us) {
+        return BUTTON_EVENT_NONE;
+    }
+
+    db->lockout_until_us = BUTTON_DEBOUNCE_NO_DEADLINE;
+    if (db->raw_level == db->stable_level) {
+        return BUTTON_EVENT_NONE;
+    }
+
+    // The pin settled on a different level than the one accepted at the
+    // leading edge; it has been stable since the last edge.
+    return accept_level(db, db->raw_level, db->last_edge_us);
+}
+
+int64_t button_debounce_deadline(const button_debounce_t *db) {
+    return db->lockout_until_us;
+}
+
+bool button_debounce_is_pressed(const button_debounce_t *db) {
+    return db->stable_level == db->active_level;
+}
+
+int64_t button_debounce_held_us(const button_debounce_t *db, int64_t now_us) {
+    if (!button_debounce_is_pressed(db) || now_us < db->pressed_at_us) {
+        return 0;
+    }
+    return now_us - db->pressed_at_us;
+}
@@ -0,0 +1,53 @@
+#ifndef BUTTON_DEBOUNCE_H
+#define BUTTON_DEBOUNCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Edge-driven debounce state machine for a push button.
+//
+// Raw edges come from the GPIO ISR as (level, timestamp) pairs. The first
+// edge that changes the debounced level is accepted immediately, so press
+// latency is bounded by the ISR rather than by a polling interval. Further
+// edges inside the settle window are treated as contact bounce; once the
+// window expires, button_debounce_poll() reconciles the debounced level
+// with the last raw level seen.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+#define BUTTON_DEBOUNCE_NO_DEADLINE (-1)
+
+typedef enum {
+    BUTTON_EVENT_NONE = 0,
+    BUTTON_EVENT_PRESS,
+    BUTTON_EVENT_RELEASE,
+} button_event_t;
+
+typedef struct {
+    int active_level;         // raw level that means "pressed"
+    int64_t settle_us;        // bounce window after each edge
+    int stable_level;         // debounced level
+    int raw_level;            // last raw level reported by the ISR
+    int64_t last_edge_us;     // timestamp of the last raw edge
+    int64_t lockout_until_us; // end of the bounce window, or NO_DEADLINE
+    int64_t pressed_at_us;    // when the current press was accepted
+} button_debounce_t;
+
+void button_debounce_init(button_debounce_t *db, int active_level, int64_t settle_us);
+
+// Feed one raw edge. Call button_debounce_poll() with the same timestamp
+// first so that an expired bounce window is resolved before the new edge.
+button_event_t button_debounce_edge(button_debounce_t *db, int level, int64_t time_us);
+
+// Resolve the bounce window if it has expired by now_us.
+button_event_t button_debounce_poll(button_debounce_t *db, int64_t now_us);
+
+// Time at which button_debounce_poll() next needs to run, or NO_DEADLINE.
+int64_t button_debounce_deadline(const button_debounce_t *db);
+
+bool button_debounce_is_pressed(const button_debounce_t *db);
+
+// How long the button has been held, or 0 if it is released.
+int64_t button_debounce_held_us(const button_debounce_t *db, int64_t now_us);
+
+#endif // BUTTON_DEBOUNCE_H
@@ -441,6 +441,70 @@ static const char CAPTIVE_PORTAL_HTML[] =
 "        event.currentTarget.querySelector(\"input\").checked = true;\n"
 "      }\n"
 "\n"
+"      // This browser's time zone as a POSIX TZ rule for the device, derived\n"
+"      // from this year's UTC offsets and DST changes. Same algorithm as\n"
+"      // posixTimezone() in the web app.\n"
+"      function posixTimezone() {\n"
+"        const MINUTE = 60000;\n"
+"        const DAY = 1440 * MINUTE;\n"
+"        const year = new Date().getFullYear();\n"
+"        const offsetAt = (t) => -new Date(t).getTimezoneOffset();\n"
+"        const pad = (n) => String(n).padStart(2, \"0\");\n"
+"\n"
+"        const changes = [];\n"
+"        for (let t = Date.UTC(year, 0, 1); t < Date.UTC(year + 1, 0, 1); t += DAY) {\n"
+"          const before = offsetAt(t);\n"
+"          if (offsetAt(t + DAY) === before) continue;\n"
+"          let lo = t;\n"
+"          let hi = t + DAY;\n"
+"          while (hi - lo > MINUTE) {\n"
+"            const mid = lo + Math.floor((hi - lo) / MINUTE / 2) * MINUTE;\n"
+"            if (offsetAt(mid) === before) lo = mid;\n"
+"            else hi = mid;\n"
+"          }\n"
+"          changes.push({ at: hi, before, after: offsetAt(hi) });\n"
+"        }\n"
+"\n"
+"        const name = (t, offset) => {\n"
+"          for (const locale of [\"en-US\", \"en-GB\"]) {\n"
+"            const part = new Intl.DateTimeFormat(locale, { timeZoneName: \"short\" })\n"
+"              .formatToParts(new Date(t))\n"
+"              .find((p) => p.type === \"timeZoneName\");\n"
+"            if (part && /^[A-Za-z]{3,6}$/.test(part.value)) return part.value;\n"
+"          }\n"
+"          const abs = Math.abs(offset);\n"
+"          return \"<\" + (offset < 0 ? \"-\" : \"+\") + pad(Math.floor(abs / 60)) +\n"
+"            (abs % 60 ? pad(abs % 60) : \"\") + \">\";\n"
+"        };\n"
+"        // POSIX offsets count west of UTC\n"
+"        const posixOffset = (offset) => {\n"
+"          const abs = Math.abs(offset);\n"
+"          return (offset > 0 ? \"-\" : \"\") + Math.floor(abs / 60) +\n"
+"            (abs % 60 ? \":\" + pad(abs % 60) : \"\");\n"
+"        };\n"
+"        // Mm.w.d/time at the local time in effect before the change\n"
+"        const rule = (c) => {\n"
+"          const local = new Date(c.at + c.before * MINUTE);\n"
+"          const day = local.getUTCDate();\n"
+"          const days = new Date(Date.UTC(local.getUTCFullYear(), local.getUTCMonth() + 1, 0)).getUTCDate();\n"
+"          const week = day + 7 > days ? 5 : Math.ceil(day / 7);\n"
+"          const min = local.getUTCMinutes();\n"
+"          return \"M\" + (local.getUTCMonth() + 1) + \".\" + week + \".\" + local.getUTCDay() + \"/\" +\n"
+"            local.getUTCHours() + (min ? \":\" + pad(min) : \"\");\n"
+"        };\n"
+"\n"
+"        const toDst = changes.find((c) => c.after > c.before);\n"
+"        const toStd = changes.find((c) => c.after < c.before);\n"
+"        if (changes.length !== 2 || !toDst || !toStd) {\n"
+"          const offset = offsetAt(Date.now());\n"
+"          return name(Date.now(), offset) + posixOffset(offset);\n"
+"        }\n"
+"        const std = toDst.before;\n"
+"        const dst = toDst.after;\n"
+"        return name(toDst.at - 3600000, std) + posixOffset(std) + name(toDst.at, dst) +\n"
+"          (dst - std === 60 ? \"\" : posixOffset(dst)) + \",\" + rule(toDst) + \",\" + rule(toStd);\n"
+"      }\n"
+"\n"
 "      function connect() {\n"
 "        const btn = document.getElementById(\"connect-btn\");\n"
 "        const errorEl = document.getElementById(\"error-msg\");\n"
@@ -460,10 +524,17 @@ static const char CAPTIVE_PORTAL_HTML[] =
 "        btn.disabled = true;\n"
 "        btn.innerHTML = 'Connecting<span class=\"loading\"></span>';\n"
 "\n"
+"        let tz = \"\";\n"
+"        try {\n"
+"          tz = posixTimezone();\n"
+"        } catch (e) {\n"
+"          // Old browser: the device keeps its current zone\n"
+"        }\n"
+"\n"
 "        fetch(\"/api/connect\", {\n"
 "          method: \"POST\",\n"
 "          headers: { \"Content-Type\": \"application/json\" },\n"
-"          body: JSON.stringify({ ssid, password }),\n"
+"          body: JSON.stringify({ ssid, password, tz }),\n"
 "        })\n"
 "          .then((r) => r.json())\n"
 "          .then((data) => {\n"
@@ -0,0 +1,92 @@
+#include "clock_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Proleptic Gregorian conversions (H. Hinnant's days_from_civil algorithm)
+int32_t days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    const int32_t era = (year >= 0 ? year : year - 399) / 400;
+    const uint32_t yoe = (uint32_t)(year - era * 400);
+    const uint32_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+void civil_from_days(int32_t epoch_day, int *year, int *month, int *day) {
+    epoch_day += 719468;
+    const int32_t era = (epoch_day >= 0 ? epoch_day : epoch_day - 146096) / 146097;
+    const uint32_t doe = (uint32_t)(epoch_day - era * 146097);
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const uint32_t mp = (5 * doy + 2) / 153;
+    const int d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    const int m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)yoe + era * 400 + (m <= 2);
+    *month = m;
+    *day = d;
+}
+
+void epoch_day_to_date(int32_t epoch_day, char *date_str, size_t len) {
+    int year, month, day;
+    civil_from_days(epoch_day, &year, &month, &day);
+    snprintf(date_str, len, "%04d-%02d-%02d", year, month, day);
+}
+
+time_t next_local_midnight(time_t now) {
+    struct tm midnight;
+    localtime_r(&now, &midnight);
+    midnight.tm_mday++;  // mktime() normalises the overflow
+    midnight.tm_hour = 0;
+    midnight.tm_min = 0;
+    midnight.tm_sec = 0;
+    midnight.tm_isdst = -1;  // whichever applies at that midnight
+    return mktime(&midnight);
+}
+
+bool parse_http_date(const char *value, int64_t *epoch_s) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char weekday[4], month_name[4], zone[4];
+    int day, year, hour, minute, second, consumed = 0;
+
+    if (sscanf(value, "%3[A-Za-z], %2d %3[A-Za-z] %4d %2d:%2d:%2d %3[A-Z]%n", weekday, &day,
+               month_name, &year, &hour, &minute, &second, zone, &consumed) != 8 ||
+        value[consumed] != '\0' || strlen(month_name) != 3 || strcmp(zone, "GMT") != 0) {
+        return false;
+    }
+
+    const char *match = strstr(months, month_name);
+    if (!match || (match - months) % 3 != 0) return false;
+    int month = (int)(match - months) / 3 + 1;
+
+    // Day 31 of a 30-day month would silently roll into the next one
+    int year_out, month_out, day_out;
+    int32_t epoch_day = days_from_civil(year, month, day);
+    civil_from_days(epoch_day, &year_out, &month_out, &day_out);
+    if (day < 1 || month_out != month || day_out != day || hour < 0 || hour > 23 ||
+        minute < 0 || minute > 59 || second < 0 || second > 60) {
+        return false;
+    }
+
+    *epoch_s = (int64_t)epoch_day * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+bool timezone_rule_from_offset(long offset_s, char *rule, size_t len) {
+    if (offset_s < -14 * 3600 || offset_s > 14 * 3600) return false;
+
+    long abs_s = offset_s < 0 ? -offset_s : offset_s;
+    int hours = (int)(abs_s / 3600);
+    int minutes = (int)(abs_s % 3600 / 60);
+    char sign = offset_s < 0 ? '-' : '+';
+    // POSIX counts offsets west of Greenwich as positive
+    const char *posix_sign = offset_s > 0 ? "-" : "";
+
+    int n;
+    if (minutes) {
+        n = snprintf(rule, len, "<%c%02d%02d>%s%d:%02d", sign, hours, minutes, posix_sign, hours, minutes);
+    } else {
+        n = snprintf(rule, len, "<%c%02d>%s%d", sign, hours, posix_sign, hours);
+    }
+    return n > 0 && (size_t)n < len;
+}
@@ -0,0 +1,35 @@
+#ifndef CLOCK_UTIL_H
+#define CLOCK_UTIL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Calendar helpers shared by the streak, journal and webhook code.
+// "Epoch day" is the number of days since 1970-01-01 in local time.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+int32_t days_from_civil(int year, int month, int day);
+void civil_from_days(int32_t epoch_day, int *year, int *month, int *day);
+
+// Format an epoch day as YYYY-MM-DD (len must be at least 11)
+void epoch_day_to_date(int32_t epoch_day, char *date_str, size_t len);
+
+// First local midnight strictly after now, in the zone set by TZ. Days with
+// a DST change come out as 23 or 25 hours; where the change skips midnight
+// itself, the day starts at the change.
+time_t next_local_midnight(time_t now);
+
+// Parse an HTTP Date header in IMF-fixdate form ("Sun, 06 Nov 1994 08:49:37
+// GMT", RFC 7231 7.1.1.1) into seconds since the Unix epoch. Returns false
+// for anything else, including the obsolete RFC 850 and asctime forms.
+bool parse_http_date(const char *value, int64_t *epoch_s);
+
+// Fixed POSIX TZ rule for a UTC offset in seconds east of Greenwich, e.g.
+// 19800 -> "<+0530>-5:30". Returns false if the offset is beyond +-14 h or
+// the rule doesn't fit in len.
+bool timezone_rule_from_offset(long offset_s, char *rule, size_t len);
+
+#endif // CLOCK_UTIL_H
@@ -0,0 +1,201 @@
+#include "led_anim.h"
+
+#include <string.h>
+
+#define SUBSTEPS  256   // positions between neighbouring LEDs for SWEEP and BAR
+
+// ============== PATTERN TIMING ==============
+
+// Total length of one play in us, or 0 if the pattern ends on a held step
+static int64_t pattern_cycle_us(const led_pattern_t *p) {
+    int64_t total = 0;
+    for (int i = 0; i < p->count; i++) {
+        if (p->steps[i].ms == 0) return 0;
+        total += (int64_t)p->steps[i].ms * 1000;
+    }
+    return total;
+}
+
+static bool slot_finished(const led_anim_slot_t *slot, int64_t now_us) {
+    int64_t cycle_us = pattern_cycle_us(slot->pattern);
+    if (slot->pattern->count == 0) return true;
+    if (cycle_us == 0 || slot->pattern->repeat == 0) return false;
+    return now_us - slot->start_us >= cycle_us * slot->pattern->repeat;
+}
+
+// Where a pattern is at now_us: the step, the time into it and the step
+// drawn before it (-1 = the base display, for the very first step)
+typedef struct {
+    int step;
+    int prev;
+    int64_t t_us;
+} step_pos_t;
+
+static step_pos_t locate(const led_anim_slot_t *slot, int64_t now_us) {
+    const led_pattern_t *p = slot->pattern;
+    int64_t elapsed_us = now_us - slot->start_us;
+    if (elapsed_us < 0) elapsed_us = 0;
+
+    int64_t cycle_us = pattern_cycle_us(p);
+    bool first_play = true;
+    if (cycle_us > 0) {
+        first_play = elapsed_us < cycle_us;
+        elapsed_us %= cycle_us;
+    }
+
+    step_pos_t pos = {0, -1, 0};
+    for (int i = 0; i < p->count; i++) {
+        int64_t step_us = (int64_t)p->steps[i].ms * 1000;
+        if (step_us == 0 || elapsed_us < step_us || i == p->count - 1) {
+            pos.step = i;
+            pos.t_us = elapsed_us;
+            break;
+        }
+        elapsed_us -= step_us;
+    }
+    if (pos.step > 0) {
+        pos.prev = pos.step - 1;
+    } else if (!first_play) {
+        pos.prev = p->count - 1;
+    }
+    return pos;
+}
+
+// ============== FRAMES ==============
+
+// Level of LED i, t_us into the step
+static uint8_t step_level(const led_step_t *step, int i, int count, int64_t t_us,
+                          const uint8_t *base) {
+    int64_t step_us = (int64_t)step->ms * 1000;
+
+    switch (step->kind) {
+    case LED_STEP_FILL:
+        return step->level;
+    case LED_STEP_BASE:
+        return base[i];
+    case LED_STEP_DIM:
+        return (uint8_t)(base[i] * step->level / LED_ANIM_LEVEL_MAX);
+    case LED_STEP_TODAY:
+        return i == count - 1 ? step->level : base[i];
+    case LED_STEP_SWEEP: {
+        int64_t span = (int64_t)(count - 1) * SUBSTEPS;
+        if (span == 0 || step_us == 0) return i == 0 ? step->level : 0;
+        int64_t dot = (t_us % step_us) * 2 * span / step_us;
+        if (dot > span) dot = 2 * span - dot;
+        int64_t dist = (int64_t)i * SUBSTEPS - dot;
+        if (dist < 0) dist = -dist;
+        if (dist >= SUBSTEPS) return 0;
+        return (uint8_t)(step->level * (SUBSTEPS - dist) / SUBSTEPS);
+    }
+    case LED_STEP_BAR: {
+        int64_t fill = (int64_t)count * SUBSTEPS;
+        if (step_us > 0 && t_us < step_us) fill = fill * t_us / step_us;
+        int64_t lit = fill - (int64_t)i * SUBSTEPS;
+        if (lit <= 0) return 0;
+        if (lit >= SUBSTEPS) return step->level;
+        return (uint8_t)(step->level * lit / SUBSTEPS);
+    }
+    default:
+        return base[i];
+    }
+}
+
+static bool step_moves(const led_step_t *step) {
+    return (step->kind == LED_STEP_SWEEP || step->kind == LED_STEP_BAR) && step->ms > 0;
+}
+
+static const led_anim_slot_t *top_slot(const led_anim_t *a) {
+    const led_anim_slot_t *top = NULL;
+    for (int i = 0; i < LED_ANIM_MAX_ACTIVE; i++) {
+        const led_anim_slot_t *slot = &a->slots[i];
+        if (!slot->pattern) continue;
+        if (!top || slot->pattern->priority > top->pattern->priority ||
+            (slot->pattern->priority == top->pattern->priority && slot->order > top->order)) {
+            top = slot;
+        }
+    }
+    return top;
+}
+
+// ============== API ==============
+
+void led_anim_init(led_anim_t *a) {
+    memset(a, 0, sizeof(*a));
+}
+
+bool led_anim_start(led_anim_t *a, const led_pattern_t *pattern, int64_t now_us) {
+    led_anim_slot_t *free_slot = NULL;
+    for (int i = 0; i < LED_ANIM_MAX_ACTIVE; i++) {
+        led_anim_slot_t *slot = &a->slots[i];
+        if (slot->pattern == pattern) {
+            free_slot = slot;
+            break;
+        }
+        if (!slot->pattern && !free_slot) free_slot = slot;
+    }
+    if (!free_slot) return false;
+
+    free_slot->pattern = pattern;
+    free_slot->start_us = now_us;
+    free_slot->order = a->next_order++;
+    return true;
+}
+
+void led_anim_stop(led_anim_t *a, const led_pattern_t *pattern) {
+    for (int i = 0; i < LED_ANIM_MAX_ACTIVE; i++) {
+        if (a->slots[i].pattern == pattern) {
+            a->slots[i].pattern = NULL;
+        }
+    }
+}
+
+int64_t led_anim_end_us(const led_anim_t *a, const led_pattern_t *pattern) {
+    for (int i = 0; i < LED_ANIM_MAX_ACTIVE; i++) {
+        const led_anim_slot_t *slot = &a->slots[i];
+        if (slot->pattern != pattern) continue;
+        int64_t cycle_us = pattern_cycle_us(pattern);
+        if (cycle_us == 0 || pattern->repeat == 0) return LED_ANIM_NO_DEADLINE;
+        return slot->start_us + cycle_us * pattern->repeat;
+    }
+    return LED_ANIM_NO_DEADLINE;
+}
+
+int64_t led_anim_render(led_anim_t *a, int64_t now_us, const uint8_t *base,
+                        uint8_t *out, int count, bool *animating) {
+    for (int i = 0; i < LED_ANIM_MAX_ACTIVE; i++) {
+        if (a->slots[i].pattern && slot_finished(&a->slots[i], now_us)) {
+            a->slots[i].pattern = NULL;
+        }
+    }
+
+    const led_anim_slot_t *top = top_slot(a);
+    if (animating) *animating = (top != NULL);
+    if (!top) {
+        memcpy(out, base, (size_t)count);
+        return LED_ANIM_NO_DEADLINE;
+    }
+
+    const led_pattern_t *p = top->pattern;
+    step_pos_t pos = locate(top, now_us);
+    const led_step_t *step = &p->steps[pos.step];
+    int64_t fade_us = (int64_t)step->fade_ms * 1000;
+    bool fading = pos.t_us < fade_us;
+
+    for (int i = 0; i < count; i++) {
+        int level = step_level(step, i, count, pos.t_us, base);
+        if (fading) {
+            int from = pos.prev < 0 ? base[i]
+                : step_level(&p->steps[pos.prev], i, count, (int64_t)p->steps[pos.prev].ms * 1000, base);
+            level = from + (int)((level - from) * pos.t_us / fade_us);
+        }
+        out[i] = (uint8_t)level;
+    }
+
+    if (fading || step_moves(step)) {
+        return now_us + LED_ANIM_FRAME_MS * 1000;
+    }
+    if (step->ms == 0) {
+        return LED_ANIM_NO_DEADLINE;
+    }
+    return now_us + (int64_t)step->ms * 1000 - pos.t_us;
+}
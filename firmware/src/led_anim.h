@@ -0,0 +1,86 @@
+#ifndef LED_ANIM_H
+#define LED_ANIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Declarative LED effects drawn over the streak display.
+//
+// A pattern is a table of steps. Each step describes a whole frame (every
+// LED at one level, the streak display, a dot sweeping across, ...), how
+// long it lasts and how long it fades in from the step before. Patterns
+// play a set number of times or until stopped. The highest priority
+// running pattern is drawn; the others keep their timing in the
+// background. led_anim_render() computes the frame for any moment and
+// returns when the picture next changes, so the caller only has to wake
+// while something moves.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+#define LED_ANIM_LEVEL_MAX    255
+#define LED_ANIM_MAX_ACTIVE   8
+#define LED_ANIM_NO_DEADLINE  (-1)
+
+// Frame interval while a step is moving
+#ifndef LED_ANIM_FRAME_MS
+#define LED_ANIM_FRAME_MS 20
+#endif
+
+typedef enum {
+    LED_STEP_FILL,    // every LED at level
+    LED_STEP_BASE,    // the streak display
+    LED_STEP_DIM,     // the streak display scaled by level
+    LED_STEP_TODAY,   // the streak display with the newest LED at level
+    LED_STEP_SWEEP,   // a dot at level runs to the newest LED and back
+    LED_STEP_BAR,     // a bar at level fills from the oldest LED
+} led_step_kind_t;
+
+typedef struct {
+    uint8_t kind;       // led_step_kind_t
+    uint8_t level;
+    uint16_t fade_ms;   // crossfade from the previous step's last frame
+    uint16_t ms;        // length, fade included; 0 = hold until stopped (last step only)
+} led_step_t;
+
+typedef struct {
+    const led_step_t *steps;
+    uint8_t count;
+    uint8_t priority;   // higher is drawn over lower
+    uint8_t repeat;     // times played, 0 = until stopped
+} led_pattern_t;
+
+#define LED_PATTERN(steps, priority, repeat) \
+    { (steps), (uint8_t)(sizeof(steps) / sizeof((steps)[0])), (priority), (repeat) }
+
+typedef struct {
+    const led_pattern_t *pattern;   // NULL = free slot
+    int64_t start_us;
+    uint32_t order;                 // later starts win priority ties
+} led_anim_slot_t;
+
+typedef struct {
+    led_anim_slot_t slots[LED_ANIM_MAX_ACTIVE];
+    uint32_t next_order;
+} led_anim_t;
+
+void led_anim_init(led_anim_t *a);
+
+// Start a pattern, or restart it from its first step if already running.
+// Returns false if LED_ANIM_MAX_ACTIVE other patterns are running.
+bool led_anim_start(led_anim_t *a, const led_pattern_t *pattern, int64_t now_us);
+
+void led_anim_stop(led_anim_t *a, const led_pattern_t *pattern);
+
+// Time at which a pattern that plays a set number of times ends, or
+// NO_DEADLINE if it isn't running or plays until stopped.
+int64_t led_anim_end_us(const led_anim_t *a, const led_pattern_t *pattern);
+
+// Draw the frame at now_us into out, over base (count LEDs, count - 1 =
+// today). Finished patterns are dropped. *animating tells whether a
+// pattern is showing (may be NULL). Returns the time of the next change,
+// or NO_DEADLINE if the frame holds until the next start, stop or base
+// change.
+int64_t led_anim_render(led_anim_t *a, int64_t now_us, const uint8_t *base,
+                        uint8_t *out, int count, bool *animating);
+
+#endif // LED_ANIM_H
@@ -0,0 +1,430 @@
+#include "led_driver.h"
+#include "led_route.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#if LED_BACKEND == LED_BACKEND_LEDC
+#include "driver/ledc.h"
+#include "esp_rom_gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "soc/ledc_periph.h"
+#include "soc/soc_caps.h"
+#elif LED_BACKEND == LED_BACKEND_STRIP
+#include "led_strip.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#else
+#include "driver/dedic_gpio.h"
+#include "hal/dedic_gpio_cpu_ll.h"
+#endif
+
+#if LED_BENCHMARK
+#if LED_BACKEND != LED_BACKEND_GPIO
+#error "LED_BENCHMARK needs LED_BACKEND=LED_BACKEND_GPIO"
+#endif
+#include "esp_cpu.h"
+#endif
+
+static const char *TAG = "led";
+
+#define LED_BRIGHTNESS_FADE_MS  1000
+#define LED_GAMMA               2.2f
+
+#if LED_BACKEND == LED_BACKEND_STRIP
+#define LED_PIN_COUNT  1
+#else
+#define LED_PIN_COUNT  LED_COUNT
+#endif
+
+static gpio_num_t s_pins[LED_PIN_COUNT];
+static SemaphoreHandle_t s_mutex;
+static uint8_t s_levels[LED_COUNT];              // last frame, before brightness
+static uint8_t s_brightness = LED_LEVEL_MAX;
+
+// Perceived level -> output value in 0..max
+static uint32_t gamma_correct(int level, uint32_t max) {
+    return (uint32_t)lroundf(powf(level / (float)LED_LEVEL_MAX, LED_GAMMA) * max);
+}
+
+#if LED_BACKEND == LED_BACKEND_LEDC
+
+// ============== LEDC BACKEND ==============
+// The C6 has SOC_LEDC_CHANNEL_NUM (6) PWM channels for 7 LEDs, so the
+// newest days get LEDC channels and the oldest borrows one. The streak
+// display has a single lit level, so through the GPIO matrix that LED
+// shows the output of a channel heading to the same duty, fades included,
+// or is a plain GPIO when off or full. Only while an effect gives it a
+// level no channel has does it jump to the nearest lit one, or to full
+// (see led_route.h). Nothing here takes
+// a PM lock, so the chip still light-sleeps with every LED lit.
+#define LED_PWM_TIMER       LEDC_TIMER_0
+#define LED_PWM_MODE        LEDC_LOW_SPEED_MODE
+#define LED_PWM_BITS        13
+#define LED_PWM_FREQ_HZ     1000  // RC_FAST (~17.5 MHz) allows up to ~2 kHz at 13 bits
+#define LED_DUTY_MAX        ((1u << LED_PWM_BITS) - 1)
+
+#if LED_COUNT > SOC_LEDC_CHANNEL_NUM
+#define LED_SHARED_COUNT  (LED_COUNT - SOC_LEDC_CHANNEL_NUM)
+#else
+#define LED_SHARED_COUNT  0
+#endif
+#define LED_ROUTE_GPIO  (-1)  // driven as a plain GPIO, not by a channel
+
+static uint16_t s_gamma[LED_LEVEL_MAX + 1];      // perceived level -> duty
+static uint32_t s_duty[LED_COUNT];               // duty each channel is heading to
+static int s_route[LED_SHARED_COUNT > 0 ? LED_SHARED_COUNT : 1];  // channel a shared LED shows
+
+static void backend_init(void) {
+    for (int i = 0; i <= LED_LEVEL_MAX; i++) {
+        s_gamma[i] = (uint16_t)gamma_correct(i, LED_DUTY_MAX);
+    }
+
+    // RC_FAST keeps running in light sleep, unlike the APB clock
+    ledc_timer_config_t timer = {
+        .speed_mode = LED_PWM_MODE,
+        .duty_resolution = (ledc_timer_bit_t)LED_PWM_BITS,
+        .timer_num = LED_PWM_TIMER,
+        .freq_hz = LED_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_USE_RC_FAST_CLK,
+    };
+    ESP_ERROR_CHECK(ledc_timer_config(&timer));
+
+    for (int i = LED_SHARED_COUNT; i < LED_COUNT; i++) {
+        ledc_channel_config_t channel = {
+            .gpio_num = s_pins[i],
+            .speed_mode = LED_PWM_MODE,
+            .channel = (ledc_channel_t)(i - LED_SHARED_COUNT),
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = LED_PWM_TIMER,
+            .duty = 0,
+            .hpoint = 0,
+            .sleep_mode = LEDC_SLEEP_MODE_KEEP_ALIVE,
+        };
+        ESP_ERROR_CHECK(ledc_channel_config(&channel));
+    }
+    ESP_ERROR_CHECK(ledc_fade_func_install(0));
+
+    for (int i = 0; i < LED_SHARED_COUNT; i++) {
+        gpio_set_direction(s_pins[i], GPIO_MODE_OUTPUT);
+        gpio_set_level(s_pins[i], 0);
+        s_route[i] = LED_ROUTE_GPIO;
+    }
+
+    ESP_LOGI(TAG, "LEDC PWM: %d channels at %d Hz, %d LEDs sharing them", LED_COUNT - LED_SHARED_COUNT,
+             LED_PWM_FREQ_HZ, LED_SHARED_COUNT);
+}
+
+// The gamma curve takes the lowest levels to 0; keep a lit LED lit
+static uint32_t level_duty(uint8_t level) {
+    uint32_t duty = s_gamma[level];
+    return level && !duty ? 1 : duty;
+}
+
+static void backend_set(int i, uint8_t level, uint32_t fade_ms) {
+    uint32_t duty = level_duty(level);
+    if (duty == s_duty[i]) return;
+    s_duty[i] = duty;
+
+    ledc_channel_t channel = (ledc_channel_t)(i - LED_SHARED_COUNT);
+    ledc_fade_stop(LED_PWM_MODE, channel);
+    if (fade_ms == 0) {
+        ledc_set_duty_and_update(LED_PWM_MODE, channel, duty, 0);
+    } else {
+        ledc_set_fade_time_and_start(LED_PWM_MODE, channel, duty, fade_ms, LEDC_FADE_NO_WAIT);
+    }
+}
+
+// Point a shared LED at the channel heading to its duty, else at the
+// nearest lit channel or plain off or on
+static void backend_route(int i, uint8_t level) {
+    int pick = led_route_pick(level_duty(level), &s_duty[LED_SHARED_COUNT],
+                              LED_COUNT - LED_SHARED_COUNT, LED_DUTY_MAX);
+    int route = pick >= 0 ? pick : LED_ROUTE_GPIO;
+
+    if (route == LED_ROUTE_GPIO) {
+        gpio_set_level(s_pins[i], pick == LED_ROUTE_ON);
+    }
+    if (route == s_route[i]) return;
+    s_route[i] = route;
+    esp_rom_gpio_connect_out_signal(s_pins[i],
+                                    route == LED_ROUTE_GPIO ? SIG_GPIO_OUT_IDX
+                                        : ledc_periph_signal[LED_PWM_MODE].sig_out0_idx + route,
+                                    false, false);
+}
+
+static void backend_show(const uint8_t levels[LED_COUNT], uint32_t fade_ms) {
+    for (int i = LED_SHARED_COUNT; i < LED_COUNT; i++) {
+        backend_set(i, levels[i], fade_ms);
+    }
+    for (int i = 0; i < LED_SHARED_COUNT; i++) {
+        backend_route(i, levels[i]);
+    }
+}
+
+#elif LED_BACKEND == LED_BACKEND_STRIP
+
+// ============== STRIP BACKEND ==============
+// Frames land in a framebuffer (s_from/s_to plus the fade timing) and the
+// strip task turns it into pixels and refreshes the strip, stepping fades
+// every LED_STRIP_FRAME_MS. Callers never wait for the RMT transfer (30 us
+// per LED). The strip latches what it was sent, so nothing is sent while
+// the picture is still. The RMT channel stays enabled from init, though,
+// and holds a PM lock, so with this backend the chip doesn't light-sleep.
+// RMT DMA is used where the chip has it; the C6's RMT has none and is fed
+// from its ping-pong memory blocks instead.
+#ifndef LED_STRIP_COLOR
+#define LED_STRIP_COLOR      0xFF7000  // RGB of an LED at full level
+#endif
+#define LED_STRIP_RES_HZ     (10 * 1000 * 1000)
+#define LED_STRIP_FRAME_MS   20
+#define LED_STRIP_TASK_STACK 3072
+#if SOC_RMT_SUPPORT_DMA
+#define LED_STRIP_WITH_DMA   1
+#else
+#define LED_STRIP_WITH_DMA   0
+#endif
+
+static led_strip_handle_t s_strip;
+static TaskHandle_t s_strip_task;
+static uint8_t s_gamma[LED_LEVEL_MAX + 1];
+static uint8_t s_from[LED_COUNT];     // frame the current fade started from
+static uint8_t s_to[LED_COUNT];       // frame it ends on
+static int64_t s_fade_start_us;
+static uint32_t s_fade_ms;
+
+// The frame at now_us, with s_mutex held. Returns true while still fading.
+static bool strip_frame_at(int64_t now_us, uint8_t frame[LED_COUNT]) {
+    int64_t elapsed_us = now_us - s_fade_start_us;
+    int64_t fade_us = (int64_t)s_fade_ms * 1000;
+    if (elapsed_us >= fade_us) {
+        memcpy(frame, s_to, LED_COUNT);
+        return false;
+    }
+    for (int i = 0; i < LED_COUNT; i++) {
+        frame[i] = (uint8_t)(s_from[i] + ((int)s_to[i] - s_from[i]) * elapsed_us / fade_us);
+    }
+    return true;
+}
+
+static void strip_send(const uint8_t frame[LED_COUNT]) {
+    for (int i = 0; i < LED_COUNT; i++) {
+        uint32_t g = s_gamma[frame[i]];
+        if (frame[i] && !g) g = 1;  // the gamma curve takes the lowest levels to 0
+        led_strip_set_pixel(s_strip, i,
+                            ((LED_STRIP_COLOR >> 16) & 0xFF) * g / 255,
+                            ((LED_STRIP_COLOR >> 8) & 0xFF) * g / 255,
+                            (LED_STRIP_COLOR & 0xFF) * g / 255);
+    }
+    led_strip_refresh(s_strip);
+}
+
+static void strip_task(void *arg) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        bool fading;
+        do {
+            uint8_t frame[LED_COUNT];
+            xSemaphoreTake(s_mutex, portMAX_DELAY);
+            fading = strip_frame_at(esp_timer_get_time(), frame);
+            xSemaphoreGive(s_mutex);
+
+            strip_send(frame);
+            if (fading) vTaskDelay(pdMS_TO_TICKS(LED_STRIP_FRAME_MS));
+        } while (fading);
+    }
+}
+
+static void backend_init(void) {
+    for (int i = 0; i <= LED_LEVEL_MAX; i++) {
+        s_gamma[i] = (uint8_t)gamma_correct(i, 255);
+    }
+
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = s_pins[0],
+        .max_leds = LED_COUNT,
+        .led_model = LED_MODEL_WS2812,
+        .color_component_format = LED_STRIP_COLOR_COMPONENT_FMT_GRB,
+    };
+    led_strip_rmt_config_t rmt_config = {
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = LED_STRIP_RES_HZ,
+        .flags = {
+            .with_dma = LED_STRIP_WITH_DMA,
+        },
+    };
+    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &s_strip));
+    led_strip_clear(s_strip);
+
+    xTaskCreate(strip_task, "led_strip", LED_STRIP_TASK_STACK, NULL, 6, &s_strip_task);
+    ESP_LOGI(TAG, "LED strip: %d LEDs on GPIO %d, RMT %s DMA", LED_COUNT, s_pins[0],
+             LED_STRIP_WITH_DMA ? "with" : "without");
+}
+
+// Called with s_mutex held: fade on from whatever is showing right now
+static void backend_show(const uint8_t levels[LED_COUNT], uint32_t fade_ms) {
+    int64_t now_us = esp_timer_get_time();
+    uint8_t current[LED_COUNT];
+    strip_frame_at(now_us, current);
+    if (!memcmp(current, levels, LED_COUNT) && !memcmp(s_to, levels, LED_COUNT)) return;
+
+    memcpy(s_from, current, LED_COUNT);
+    memcpy(s_to, levels, LED_COUNT);
+    s_fade_start_us = now_us;
+    s_fade_ms = fade_ms;
+    xTaskNotifyGive(s_strip_task);
+}
+
+#else
+
+// ============== GPIO BACKEND ==============
+// The pins form one dedicated-GPIO bundle, with bit i of the bundle = LED
+// i, the same order as the streak bits. A whole frame is then a single CSR
+// write from the CPU, so all LEDs change together and a frame costs a few
+// cycles instead of one driver call per pin.
+
+static dedic_gpio_bundle_handle_t s_bundle;
+static uint32_t s_bundle_offset;  // first dedicated output channel of the bundle
+
+static void backend_init(void) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 0,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    int gpios[LED_COUNT];
+    for (int i = 0; i < LED_COUNT; i++) {
+        io_conf.pin_bit_mask |= (1ULL << s_pins[i]);
+        gpios[i] = s_pins[i];
+    }
+    gpio_config(&io_conf);
+
+    dedic_gpio_bundle_config_t bundle_config = {
+        .gpio_array = gpios,
+        .array_size = LED_COUNT,
+        .flags = {
+            .out_en = 1,
+        },
+    };
+    ESP_ERROR_CHECK(dedic_gpio_new_bundle(&bundle_config, &s_bundle));
+    dedic_gpio_get_out_offset(s_bundle, &s_bundle_offset);
+    dedic_gpio_cpu_ll_write_all(0);
+    ESP_LOGI(TAG, "GPIO on/off outputs, dedicated GPIO channels %lu-%lu",
+             (unsigned long)s_bundle_offset, (unsigned long)(s_bundle_offset + LED_COUNT - 1));
+}
+
+// This is the only bundle, so writing every dedicated channel is safe
+static inline void bundle_write(uint32_t mask) {
+    dedic_gpio_cpu_ll_write_all(mask << s_bundle_offset);
+}
+
+static void backend_show(const uint8_t levels[LED_COUNT], uint32_t fade_ms) {
+    uint32_t mask = 0;
+    for (int i = 0; i < LED_COUNT; i++) {
+        if (levels[i]) mask |= 1u << i;
+    }
+    bundle_write(mask);
+}
+
+#endif
+
+// ============== FRAMES ==============
+
+// Called with s_mutex held
+static void render(uint32_t fade_ms) {
+    uint8_t levels[LED_COUNT];
+    for (int i = 0; i < LED_COUNT; i++) {
+        uint8_t level = (uint8_t)((s_levels[i] * s_brightness + LED_LEVEL_MAX / 2) / LED_LEVEL_MAX);
+        // Dimming never turns a lit LED off
+        if (s_levels[i] && !level) level = 1;
+        levels[i] = level;
+    }
+    backend_show(levels, fade_ms);
+}
+
+void led_driver_init(const gpio_num_t *pins) {
+    memcpy(s_pins, pins, sizeof(s_pins));
+    s_mutex = xSemaphoreCreateMutex();
+    backend_init();
+    for (int i = 0; i < LED_PIN_COUNT; i++) {
+        gpio_sleep_sel_dis(s_pins[i]);  // keep driving the LEDs in light sleep
+    }
+}
+
+void led_driver_show(const uint8_t levels[LED_COUNT], uint32_t fade_ms) {
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    memcpy(s_levels, levels, sizeof(s_levels));
+    render(fade_ms);
+    xSemaphoreGive(s_mutex);
+}
+
+void led_driver_fill(uint8_t level, uint32_t fade_ms) {
+    uint8_t levels[LED_COUNT];
+    memset(levels, level, sizeof(levels));
+    led_driver_show(levels, fade_ms);
+}
+
+void led_driver_set_brightness(uint8_t brightness) {
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (brightness != s_brightness) {
+        s_brightness = brightness;
+        render(LED_BRIGHTNESS_FADE_MS);
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+#if LED_BENCHMARK
+
+// ============== BENCHMARK ==============
+#define LED_BENCH_FRAMES  1000
+
+static uint32_t bench_frame(uint32_t n) {
+    return (n * 37) & ((1u << LED_COUNT) - 1);  // varied patterns, every bit toggles
+}
+
+// Cycles per frame for the old per-pin gpio_set_level() loop, the public
+// bundle API and the single CSR write. Interrupts stay off while each path
+// runs so only the frame writes are counted. While the bundle owns the
+// pins the gpio_set_level() writes don't reach them, but they cost the same.
+void led_driver_benchmark(void) {
+    uint32_t cycles[3];
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (int path = 0; path < 3; path++) {
+        portDISABLE_INTERRUPTS();
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (uint32_t n = 0; n < LED_BENCH_FRAMES; n++) {
+            uint32_t mask = bench_frame(n);
+            if (path == 0) {
+                for (int i = 0; i < LED_COUNT; i++) {
+                    gpio_set_level(s_pins[i], (mask >> i) & 1);
+                }
+            } else if (path == 1) {
+                dedic_gpio_bundle_write(s_bundle, (1u << LED_COUNT) - 1, mask);
+            } else {
+                bundle_write(mask);
+            }
+        }
+        cycles[path] = esp_cpu_get_cycle_count() - start;
+        portENABLE_INTERRUPTS();
+    }
+    render(0);
+    xSemaphoreGive(s_mutex);
+
+    ESP_LOGI(TAG, "Cycles per frame over %d frames: gpio_set_level x%d %lu, "
+             "dedic_gpio_bundle_write %lu, CSR write %lu",
+             LED_BENCH_FRAMES, LED_COUNT,
+             (unsigned long)(cycles[0] / LED_BENCH_FRAMES),
+             (unsigned long)(cycles[1] / LED_BENCH_FRAMES),
+             (unsigned long)(cycles[2] / LED_BENCH_FRAMES));
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef LED_DRIVER_H
+#define LED_DRIVER_H
+
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "sdkconfig.h"
+
+// Owns the streak LEDs. Frames are arrays of LED_COUNT perceived levels
+// (0 = off, LED_LEVEL_MAX = full), index 0 = oldest, LED_COUNT - 1 = today.
+// Safe to call from any task.
+//
+// Backends, chosen at build time with -DLED_BACKEND=..., except the strip,
+// which CONFIG_PRESSIT_LED_STRIP selects so the component manager only
+// fetches led_strip for it:
+//   LED_BACKEND_LEDC  hardware PWM with a gamma table and global brightness.
+//                     Fades are run by the LEDC fade engine, so the CPU is
+//                     not involved between frames and the outputs keep
+//                     running in light sleep (the timer is clocked from
+//                     RC_FAST).
+//   LED_BACKEND_GPIO  plain on/off outputs: any non-zero level is on,
+//                     brightness and fades are ignored. The pins are a
+//                     dedicated-GPIO bundle, so each frame is one CPU write.
+//   LED_BACKEND_STRIP an addressable WS2812-class strip on one data pin,
+//                     sent by RMT. Any LED_COUNT; frames are rendered from
+//                     a framebuffer by a task of the driver's own, which
+//                     also steps the fades.
+
+#define LED_BACKEND_GPIO   0
+#define LED_BACKEND_LEDC   1
+#define LED_BACKEND_STRIP  2
+
+#ifndef LED_BACKEND
+#ifdef CONFIG_PRESSIT_LED_STRIP
+#define LED_BACKEND LED_BACKEND_STRIP
+#else
+#define LED_BACKEND LED_BACKEND_LEDC
+#endif
+#endif
+#if (LED_BACKEND == LED_BACKEND_STRIP) != defined(CONFIG_PRESSIT_LED_STRIP)
+#error "Select LED_BACKEND_STRIP with CONFIG_PRESSIT_LED_STRIP (pio run -e esp32-c6-strip), not -DLED_BACKEND"
+#endif
+
+// The pin backends drive 7 LEDs; a strip can be longer, e.g. -DLED_COUNT=30
+#ifndef LED_COUNT
+#define LED_COUNT 7
+#endif
+#if LED_BACKEND != LED_BACKEND_STRIP && LED_COUNT != 7
+#error "Only LED_BACKEND_STRIP supports an LED_COUNT other than 7"
+#endif
+
+#define LED_LEVEL_MAX  255
+
+// Logs cycles per frame at boot for the on/off write paths; GPIO backend only
+#ifndef LED_BENCHMARK
+#define LED_BENCHMARK 0
+#endif
+
+// pins: one per LED, or just the data pin for a strip
+void led_driver_init(const gpio_num_t *pins);
+
+// Show a frame, crossfading from the current one over fade_ms (0 = at once).
+// Returns immediately; a fade still running is replaced.
+void led_driver_show(const uint8_t levels[LED_COUNT], uint32_t fade_ms);
+
+// Every LED at the same level
+void led_driver_fill(uint8_t level, uint32_t fade_ms);
+
+// Scale every level, e.g. dimmed at night. The frame on show fades to it.
+void led_driver_set_brightness(uint8_t brightness);
+
+#if LED_BENCHMARK
+void led_driver_benchmark(void);
+#endif
+
+#endif // LED_DRIVER_H
@@ -0,0 +1,18 @@
+#include "led_route.h"
+
+int led_route_pick(uint32_t duty, const uint32_t *channel_duty, int channels, uint32_t duty_max) {
+    if (duty == 0) return LED_ROUTE_OFF;
+
+    int route = LED_ROUTE_ON;
+    uint32_t best = duty_max - duty;
+    for (int c = 0; c < channels && best > 0; c++) {
+        // A dark channel would turn the LED off
+        if (channel_duty[c] == 0) continue;
+        uint32_t diff = channel_duty[c] > duty ? channel_duty[c] - duty : duty - channel_duty[c];
+        if (diff <= best) {
+            best = diff;
+            route = c;
+        }
+    }
+    return route;
+}
@@ -0,0 +1,24 @@
+#ifndef LED_ROUTE_H
+#define LED_ROUTE_H
+
+#include <stdint.h>
+
+// Chooses what an LED without a PWM channel of its own shows.
+//
+// The LEDC backend has fewer channels than LEDs, so the leftover LED is
+// routed through the GPIO matrix to the output of a channel heading to a
+// duty close to its own, or driven as a plain GPIO. The routing never
+// turns a lit LED off: with no lit channel close enough it is on at full.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+#define LED_ROUTE_OFF  (-1)  // plain GPIO, low
+#define LED_ROUTE_ON   (-2)  // plain GPIO, high
+
+// Pick for an LED heading to duty (0..duty_max), given the duties the
+// channels are heading to. Returns a channel index or LED_ROUTE_OFF/ON.
+// Off and full are plain GPIO levels. In between, ties go to a channel,
+// so an LED at a channel's duty follows its fades.
+int led_route_pick(uint32_t duty, const uint32_t *channel_duty, int channels, uint32_t duty_max);
+
+#endif // LED_ROUTE_H
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <time.h>
 #include <sys/time.h>
@@ -7,6 +8,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #include "esp_system.h"
 #include "esp_wifi.h"
@@ -14,14 +17,24 @@
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_http_client.h"
+#include "esp_crt_bundle.h"
 #include "esp_http_server.h"
 #include "esp_sntp.h"
+#include "esp_netif_sntp.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_rtc_time.h"
+#include "esp_partition.h"
 
 #include "nvs_flash.h"
 #include "nvs.h"
 
 #include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_attr.h"
+#include "driver/rtc_io.h"
 
 #include "esp_hmac.h"
 #include "esp_efuse.h"
@@ -32,26 +45,144 @@
 #include "lwip/netdb.h"
 
 #include "captive_portal.h"
+#include "button_debounce.h"
+#include "press_journal.h"
+#include "press_coalescer.h"
+#include "clock_util.h"
+#include "streak_engine.h"
+#include "press_history.h"
+#include "led_driver.h"
+#include "led_anim.h"
 
 static const char *TAG = "streak";
 
 // ============== PIN CONFIGURATION ==============
 // LEDs: index 0 = oldest (left), index 6 = today (right)
 // Note: ESP32-C6 has different GPIO mapping - update these for your board
-static const gpio_num_t LED_PINS[7] = {
+#if LED_BACKEND == LED_BACKEND_STRIP
+// Data pin of the strip; GPIO8 is the DevKitC-1's on-board WS2812
+static const gpio_num_t LED_PINS[1] = { GPIO_NUM_8 };
+#else
+static const gpio_num_t LED_PINS[LED_COUNT] = {
     GPIO_NUM_0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3,
     GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6
 };
+#endif
 static const gpio_num_t BUTTON_PIN = GPIO_NUM_7;
 // BOOT button on ESP32-C6-DevKitC-1 is GPIO9 - used for factory reset
 static const gpio_num_t BOOT_BUTTON_PIN = GPIO_NUM_9;
 
+// ============== LED CONFIGURATION ==============
+// Brightness scales every frame. Between LED_NIGHT_START_HOUR and
+// LED_NIGHT_END_HOUR local time the LEDs dim to LED_NIGHT_BRIGHTNESS.
+#ifndef LED_BRIGHTNESS
+#define LED_BRIGHTNESS        255
+#endif
+#ifndef LED_NIGHT_BRIGHTNESS
+#define LED_NIGHT_BRIGHTNESS  40
+#endif
+#define LED_NIGHT_START_HOUR  22
+#define LED_NIGHT_END_HOUR    7
+#define LED_FADE_MS           250   // streak changes crossfade over this long
+
+// Each LED shows LED_DAYS_PER_LED days of the press history, lit in
+// proportion to the pressed ones; e.g. 52 LEDs x 7 days for a year of
+// weeks on a strip. Windows end today, so the newest LED is the last
+// LED_DAYS_PER_LED days rather than a calendar week.
+#ifndef LED_DAYS_PER_LED
+#define LED_DAYS_PER_LED      1
+#endif
+#if LED_COUNT * LED_DAYS_PER_LED > PRESS_HISTORY_DAYS
+#error "LED_COUNT * LED_DAYS_PER_LED is longer than the press history"
+#endif
+
+#define LED_TASK_STACK_SIZE   3072
+
 // ============== NTP CONFIGURATION ==============
+// Sync is asynchronous: nothing waits for it. The DHCP server's NTP
+// server (if offered) is tried first, then the public ones. If no sync
+// arrives the SNTP client is restarted with exponential backoff.
 static const char *NTP_SERVER = "pool.ntp.org";
-static long gmt_offset_sec = 0;
+static const char *NTP_SERVER_2 = "time.google.com";
+#define NTP_RETRY_MIN_S     15
+#define NTP_RETRY_MAX_S     3600
+#define NTP_STALE_S         (3 * 3600)  // restart SNTP if no sync for this long
+
+// Until SNTP answers, the clock comes from a checkpoint kept in RTC memory
+// (after a soft reset or deep sleep) or from the Date header of an HTTP
+// response. Either is good enough to date presses; NTP refines it later.
+typedef enum {
+    CLOCK_SOURCE_NONE,
+    CLOCK_SOURCE_RTC,    // last known time plus RTC time elapsed since
+    CLOCK_SOURCE_HTTP,   // Date header: 1 s resolution plus request latency
+    CLOCK_SOURCE_NTP,
+} clock_source_t;
+#define HTTP_DATE_TOLERANCE_S   2           // smaller errors are left to NTP
+#define CLOCK_CHECKPOINT_MAGIC  0x434C4B31  // "CLK1"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t source;
+    int64_t epoch_us;        // wall clock when the checkpoint was taken
+    uint64_t rtc_us;         // RTC counter at the same moment
+    uint32_t check;          // RTC_NOINIT memory is random after power-on
+} clock_checkpoint_t;
+
+static RTC_NOINIT_ATTR clock_checkpoint_t s_clock_checkpoint;
+
+// ============== TIME ZONE CONFIGURATION ==============
+// The zone is a POSIX TZ rule such as "MST7MDT,M3.2.0,M11.1.0", set from
+// the captive portal or the web app (returned in webhook responses) and
+// kept in NVS. localtime_r() applies it, DST transitions included, so no
+// lookup is needed at boot. Only a device with no rule stored, i.e. one
+// updated from firmware that looked the offset up by IP, does that lookup
+// once more and keeps the result as a fixed rule - and only if the backend,
+// which pushes the web app's rule with every answer, had none for it.
+#define TZ_DEFAULT  "UTC0"
+#define TZ_MAX_LEN  64
+#define TZ_LOOKUP_URL "http://ip-api.com/json/?fields=offset"
+static char s_tz[TZ_MAX_LEN] = TZ_DEFAULT;
+static bool s_tz_stored = false;  // a rule is saved in NVS
+static bool s_tz_lookup_tried = false;  // the IP lookup ran this boot
+static bool s_tz_lookup_pending = false;  // owned by the network task
+static bool s_backend_answered = false;   // a signed request got a response
 
 // ============== WEBHOOK CONFIGURATION ==============
-static const char *WEBHOOK_URL = "https://us-central1-pressit-today.cloudfunctions.net/buttonPress";
+// Override to test against a local server, e.g.
+//   -DWEBHOOK_BASE_URL=\"https://192.168.1.20:8443\"
+#ifndef WEBHOOK_BASE_URL
+#define WEBHOOK_BASE_URL "https://us-central1-pressit-today.cloudfunctions.net"
+#endif
+static const char *WEBHOOK_URL = WEBHOOK_BASE_URL "/buttonPress";
+static const char *WEBHOOK_BATCH_URL = WEBHOOK_BASE_URL "/buttonPressBatch";
+static const char *WEBHOOK_STATE_URL = WEBHOOK_BASE_URL "/deviceState";
+#define WEBHOOK_TIMEOUT_MS     10000
+#ifndef WEBHOOK_IDLE_CLOSE_MS
+#define WEBHOOK_IDLE_CLOSE_MS  30000  // close the kept-alive connection after this long unused
+#endif
+
+// Long-lived client used only by the network task. esp_http_client keeps the
+// HTTP/1.1 connection open between requests, so presses after the first skip
+// DNS, TCP connect and the TLS handshake. Once the connection is closed, the
+// handle keeps the TLS session ticket (CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS)
+// and the next connection resumes the session instead of a full ECDHE
+// handshake. The ticket lives in RAM, which light sleep retains. It is not
+// copied to RTC memory: esp_http_client keeps the session inside its SSL
+// transport and has no API to read it out or hand one in, so after a
+// restart or a deep-sleep wake the first connection is a full handshake.
+static esp_http_client_handle_t s_webhook_client = NULL;
+static bool s_webhook_open = false;           // a connection is currently open
+static bool s_webhook_session_saved = false;  // a handshake has completed on the handle
+static int64_t s_webhook_last_used_us = 0;
+static bool s_webhook_connected = false;      // set by HTTP_EVENT_ON_CONNECTED
+static struct {
+    uint32_t full_handshakes;
+    uint32_t resumed_handshakes;
+    uint32_t reuses;
+    int64_t full_ms;
+    int64_t resumed_ms;
+    int64_t reuse_ms;
+} s_webhook_stats;
 
 // ============== HMAC CONFIGURATION ==============
 // The HMAC key must be burned to eFuse block KEY4 with purpose HMAC_UP (upstream)
@@ -63,30 +194,63 @@ static bool s_hmac_available = false;
 
 // ============== WIFI CONFIGURATION ==============
 #define WIFI_MAXIMUM_RETRY 5
+#define WIFI_CONNECT_TIMEOUT_MS 15000
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 #define AP_SSID            "The thing Will gave me"
 
+// Fast reconnect: the AP, channel and IP lease of the last connection are
+// cached in NVS so the next boot can skip the scan (and optionally DHCP).
+// If the cached AP doesn't answer, the first disconnect falls back to a
+// normal scan. Set WIFI_REUSE_IP_LEASE to also reuse the IP statically;
+// this skips DHCP entirely, so the lease is never renewed by this device.
+#ifndef WIFI_REUSE_IP_LEASE
+#define WIFI_REUSE_IP_LEASE 0
+#endif
+#define WIFI_FAST_CACHE_VERSION 1
+
+typedef struct {
+    uint8_t version;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip, netmask, gw, dns;  // network byte order
+    uint32_t full_connect_ms;       // duration of the last full-scan connect
+} wifi_fast_cache_t;
+
 static EventGroupHandle_t s_wifi_event_group = NULL;
 static int s_retry_num = 0;
-static bool s_provisioning_done = false;
+static char s_wifi_ssid[33] = {0};
+static esp_netif_t *s_sta_netif = NULL;
+#ifdef DEEP_SLEEP_MODE
+static RTC_DATA_ATTR wifi_fast_cache_t s_wifi_fast_cache;  // wakes skip the NVS read
+#else
+static wifi_fast_cache_t s_wifi_fast_cache;
+#endif
+static bool s_wifi_running = false;         // between esp_wifi_start() and esp_wifi_stop()
+static bool s_wifi_fast_connect = false;    // directed connect in progress
+static bool s_wifi_static_ip = false;       // cached lease applied, DHCP stopped
+static int64_t s_wifi_connect_start_us = 0;
+static int64_t s_wifi_associated_us = 0;
 static char s_claim_code[12] = {0};
 
 // ============== STATE ==============
-static uint8_t streak_data = 0;
-static int last_day = -1;
-static bool today_state = false;
-static bool button_pressed = false;
-static uint32_t last_debounce_time = 0;
-static const uint32_t DEBOUNCE_DELAY = 50;
-static bool last_button_state = true;
+static streak_t s_streak = {0, STREAK_NO_DAY};
+static press_history_t s_history;      // the year behind s_streak, kept in step with it
+static int32_t s_legacy_yday = -1;     // "lastDay" from older firmware, until the clock is known
 static bool ntp_synced = false;
+static clock_source_t s_clock_source = CLOCK_SOURCE_NONE;
+static bool s_streak_aligned = false;   // streak shifted to the synced date
+static int64_t s_ntp_retry_us = 0;      // next SNTP restart, 0 when not running
+static uint32_t s_ntp_backoff_s = NTP_RETRY_MIN_S;
+static uint32_t s_early_toggles = 0;    // presses made before that, not yet sent
 static bool s_netif_initialized = false;
 
-// Animation state
-static int animation_index = 0;
-static uint32_t last_animation_time = 0;
-static const uint32_t ANIMATION_INTERVAL = 100;
+// LED display: led_task draws s_led_anim over s_led_base, both guarded
+// by s_led_mutex
+static led_anim_t s_led_anim;
+static uint8_t s_led_base[LED_COUNT];
+static SemaphoreHandle_t s_led_mutex = NULL;
+static TaskHandle_t s_led_task = NULL;
 
 // HTTP Server handle
 static httpd_handle_t s_httpd = NULL;
@@ -94,38 +258,318 @@ static httpd_handle_t s_httpd = NULL;
 // DNS task handle
 static TaskHandle_t s_dns_task = NULL;
 
+// Guards s_streak/s_history, shared by the button task and main loop
+static SemaphoreHandle_t s_state_mutex = NULL;
+
+// ============== BUTTON INPUT CONFIGURATION ==============
+#define DEBOUNCE_DELAY_US      50000
+#define BUTTON_QUEUE_LENGTH    32
+#define RESET_HOLD_TIME_US     5000000
+#define BOOT_HOLD_REFRESH_MS   100
+
+// Raw edge captured by the GPIO ISR
+typedef struct {
+    gpio_num_t pin;
+    int level;
+    int64_t time_us;
+} button_edge_t;
+
+static QueueHandle_t s_button_queue = NULL;
+static button_debounce_t s_button_db;
+static button_debounce_t s_boot_db;
+
+// ============== NETWORK WORKER CONFIGURATION ==============
+#define NET_QUEUE_LENGTH       16
+#define NET_TASK_STACK_SIZE    8192
+
+typedef enum {
+    NET_EVENT_PRESS,     // a new press to journal and send
+    NET_EVENT_REPLAY,    // connectivity or time changed - retry the journal
+    NET_EVENT_CLOCK_PROBE,  // read the backend's Date header, clock unset
+    NET_EVENT_STATE_SYNC,   // read back the backend's state once idle
+    NET_EVENT_TZ_LOOKUP,    // no time zone stored - look the offset up once
+} net_event_type_t;
+
+typedef struct {
+    net_event_type_t type;
+    bool state;
+    int32_t day;        // local epoch day of the press
+    int64_t queued_us;  // esp_timer time the event was queued
+} net_event_t;
+
+typedef enum {
+    WEBHOOK_DELIVERED,
+    WEBHOOK_REJECTED,  // backend refused the payload - retrying will not help
+    WEBHOOK_FAILED,    // offline, timeout or server error - retry later
+} webhook_result_t;
+
+static QueueHandle_t s_net_queue = NULL;
+static uint32_t s_net_dropped = 0;
+static volatile int32_t s_net_overflow_day = STREAK_NO_DAY;  // day of a press that did not fit
+static press_coalescer_t s_coalescer;  // owned by the network task
+
+// ============== PRESS JOURNAL CONFIGURATION ==============
+// Presses are journaled to their own partition (see partitions.csv) until
+// the backend acknowledges them, so nothing is lost while offline
+#define JOURNAL_PARTITION_LABEL  "journal"
+#define JOURNAL_PARTITION_SUBTYPE 0x40
+#define JOURNAL_RETRY_MS         60000
+#define JOURNAL_BATCH_MAX        32     // presses per buttonPressBatch request
+#define JOURNAL_BATCH_PAYLOAD_SIZE  (96 + JOURNAL_BATCH_MAX * 64)
+#define JOURNAL_BATCH_RESPONSE_SIZE (32 + JOURNAL_BATCH_MAX * 64)
+
+// ============== STATE SYNC CONFIGURATION ==============
+// After connecting and after each rollover the device reads back what the
+// backend has for the last STATE_SYNC_DAYS days and merges it, so LEDs and
+// Firestore can't drift apart for good when a write is lost on either side
+#define STATE_SYNC_DAYS          32     // multiple of 8
+#define STATE_SYNC_MIN_INTERVAL_S 3600  // between syncs on the same day
+
+static bool s_state_sync_pending = false;  // owned by the network task
+static int32_t s_state_sync_day = STREAK_NO_DAY;
+static time_t s_state_sync_time = 0;
+static uint32_t s_history_rev = 0;  // bumped by every local toggle
+
+static const esp_partition_t *s_journal_partition = NULL;
+static press_journal_flash_t s_journal_flash;
+static press_journal_t s_journal;
+static bool s_journal_ready = false;
+static SemaphoreHandle_t s_journal_mutex = NULL;  // factory reset erases it from another task
+
+
+// ============== POWER MANAGEMENT CONFIGURATION ==============
+// With CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE the chip scales
+// the CPU clock down and enters light sleep whenever every task is blocked
+#define PM_MAX_FREQ_MHZ          160
+#define PM_MIN_FREQ_MHZ          40
+#define POWER_STATS_INTERVAL_S   600
+
+#define APP_TIME_CHANGED_BIT     BIT0   // clock set or time zone changed
+#define APP_NET_IDLE_BIT         BIT1   // network task has nothing left to send
+#define APP_NTP_SYNCED_BIT       BIT2   // SNTP set the clock
+#define APP_MIDNIGHT_BIT         BIT3   // midnight timer fired
+#define APP_STREAK_SAVE_BIT      BIT4   // streak save delay elapsed
+#define APP_BUTTON_BIT           BIT5   // button activity (battery mode)
+#define APP_PROVISIONED_BIT      BIT6   // captive portal joined a network
+
+static EventGroupHandle_t s_app_events = NULL;
+static esp_timer_handle_t s_midnight_timer = NULL;
+
+// ============== PERSISTENCE CONFIGURATION ==============
+// Streak changes only mark the RAM copy dirty. The history blob is
+// committed STREAK_SAVE_DELAY_MS after the first unsaved change (later
+// changes don't push it back), and forced out on esp_restart() and before
+// deep sleep, so a burst of toggles or a catch-up costs one flash write
+// and none of them happen on the input path. A power cut loses at most
+// that window; the presses themselves are in the journal.
+#define STREAK_SAVE_DELAY_MS     5000
+// For the wear estimate: NVS writes 32-byte entries, 126 to a 4 KB page,
+// and a page is erased each time it fills
+#define NVS_ENTRY_SIZE           32
+#define NVS_ENTRIES_PER_PAGE     126
+#define FLASH_ERASE_CYCLES       100000
+
+typedef struct {
+    uint32_t today;    // commits since the last rollover
+    uint32_t total;
+    uint32_t days;     // rollovers seen
+} flash_write_stats_t;
+
+static bool s_streak_dirty = false;  // guarded by s_state_mutex
+// press_history_hash() of the blob in NVS, so a change that was undone
+// before the save (a toggle and its undo) writes nothing. Guarded by
+// s_state_mutex.
+static bool s_history_saved = false;
+static uint32_t s_history_saved_hash = 0;
+static esp_timer_handle_t s_streak_save_timer = NULL;
+static flash_write_stats_t s_flash_writes;
+
+// ============== WIFI POWER SAVE CONFIGURATION ==============
+// While idle the STA sits in WIFI_PS_MAX_MODEM and only wakes for every
+// WIFI_IDLE_LISTEN_INTERVAL-th beacon. Each network exchange holds a
+// reference that keeps the radio at full power (WIFI_PS_NONE) until done.
+#define WIFI_IDLE_LISTEN_INTERVAL  10       // beacon intervals (~1 s) between wakes
+#define WIFI_BEACON_INTERVAL_US    102400   // typical AP beacon interval
+#define WIFI_BEACON_WAKE_US        3000     // approximate radio-on time per beacon wake
+
+static SemaphoreHandle_t s_wifi_power_mutex = NULL;
+static bool s_wifi_power_save = false;      // enabled once the STA is connected
+static int s_wifi_power_refs = 0;
+static int64_t s_wifi_power_start_us = 0;
+static int64_t s_wifi_full_power_since_us = 0;
+static int64_t s_wifi_full_power_us = 0;
+static uint32_t s_wifi_power_exchanges = 0;
+
+// ============== WIFI DUTY CYCLE CONFIGURATION ==============
+// With WIFI_DUTY_CYCLE=1 the radio is switched off completely (esp_wifi_stop)
+// whenever the network task has nothing left to send. It is started again
+// on the first toggle of a press, so association overlaps the settle window,
+// and at local midnight or every WIFI_RESYNC_INTERVAL_S to resync the clock.
+// The STA config, fast reconnect cache and TLS session survive the stop.
+#ifndef WIFI_DUTY_CYCLE
+#define WIFI_DUTY_CYCLE 0
+#endif
+#if WIFI_DUTY_CYCLE && defined(DEEP_SLEEP_MODE)
+#error "WIFI_DUTY_CYCLE is for mains-powered builds; DEEP_SLEEP_MODE already turns the radio off"
+#endif
+#ifndef WIFI_RESYNC_INTERVAL_S
+#define WIFI_RESYNC_INTERVAL_S   (6 * 3600)
+#endif
+#define WIFI_BRINGUP_TIMEOUT_MS  10000
+#define WIFI_NTP_WAIT_MS         5000
+
+#if WIFI_DUTY_CYCLE
+static bool s_wifi_connecting = false;      // started, wifi_wait_connected() not yet run
+static int64_t s_wifi_up_since_us = 0;
+static int64_t s_wifi_on_total_us = 0;
+static int64_t s_wifi_next_resync_us = 0;
+static int64_t s_wifi_ttfb_start_us = 0;    // bring-up awaiting its first response byte
+static uint32_t s_wifi_bringups = 0;
+static int64_t s_wifi_ttfb_total_ms = 0;
+#endif
+
+// ============== DEEP SLEEP CONFIGURATION ==============
+// Battery builds (pio run -e esp32-c6-battery) define DEEP_SLEEP_MODE: the
+// device deep-sleeps between presses and midnight instead of staying
+// connected, waking on BUTTON_PIN (ext1) or an RTC timer. State needed on
+// wake lives in RTC memory, so waking skips the NVS reads and the WiFi scan.
+#ifdef DEEP_SLEEP_MODE
+#define DEEP_SLEEP_AWAKE_MS         5000    // stay up this long after the last button activity
+#define DEEP_SLEEP_NET_TIMEOUT_MS   20000   // stop waiting for the network task after this
+#define DEEP_SLEEP_RETRY_S          3600    // wake to retry while presses are undelivered
+#define DEEP_SLEEP_RESYNC_S         (6 * 3600)
+#define RTC_STATE_MAGIC             0x54535250  // "PRST"
+
+typedef struct {
+    uint32_t magic;
+    press_history_t history;
+    int32_t state_sync_day;     // last backend state sync
+    time_t state_sync_time;
+    flash_write_stats_t flash_writes;
+    char tz[TZ_MAX_LEN];
+    bool tz_stored;
+    bool tz_lookup_tried;
+    bool history_saved;
+    uint32_t history_saved_hash;
+    bool time_valid;
+    time_t last_sync;           // when SNTP last set the clock
+    char ssid[33];              // the password stays in NVS
+    uint32_t button_wakes;      // button wakes that reached the backend
+    int64_t wake_to_webhook_ms; // summed over button_wakes
+} rtc_state_t;
+
+static RTC_DATA_ATTR rtc_state_t s_rtc_state;
+static esp_sleep_wakeup_cause_t s_wake_cause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static int64_t s_last_input_us = 0;
+static bool s_wake_resync = false;      // this wake restarted SNTP
+#endif
+
 
 // ============== FUNCTION DECLARATIONS ==============
 static void setup_leds(void);
 static void update_leds(void);
-static void animate_leds(void);
-static void handle_button(void);
+static void leds_play(const led_pattern_t *pattern);
+static void leds_stop(const led_pattern_t *pattern);
+static void leds_wait(const led_pattern_t *pattern);
+static void update_led_brightness(void);
+static void on_button_press(void);
+static bool toggle_today(void);
+static int32_t advance_streak(int32_t today);
 static void check_midnight_rollover(void);
-static void shift_streak(void);
-static void save_streak(void);
+static void arm_midnight_timer(void);
+static void schedule_streak_save(void);
+static void flush_streak(void);
+static void log_flash_write_stats(void);
 static void load_streak(void);
-static void sync_ntp(void);
-static int get_current_day(void);
-static void send_webhook(bool state);
+static void init_time_sync(void);
+static void start_time_sync(void);
+static void retry_time_sync(void);
+static void reconcile_clock(void);
+static bool clock_valid(void);
+static webhook_result_t send_webhook(int32_t day, bool state);
+static webhook_result_t send_press_batch(const press_journal_entry_t *entries, int count);
+static void queue_press_event(bool state);
+static void queue_timezone_lookup(void);
+static void queue_journal_replay(void);
+static void queue_state_sync(void);
+static void init_press_journal(void);
+static void start_network_task(void);
 static void get_mac_address(char *mac_str, size_t len);
-static void get_current_date(char *date_str, size_t len);
+static int32_t get_current_epoch_day(void);
+static uint16_t get_current_minute(void);
 static void generate_claim_code(char *code, size_t len);
 static bool connect_with_saved_credentials(void);
+static bool start_saved_wifi(void);
+static bool wait_for_saved_wifi(void);
 static void save_wifi_credentials(const char *ssid, const char *password);
 static void start_provisioning_mode(void);
-static void fetch_timezone(void);
+static void probe_clock(void);
+static void update_timezone(const char *tz);
 static void setup_boot_button(void);
-static void check_boot_button(void);
+static void start_button_task(void);
 static void clear_wifi_credentials(void);
 static void clear_streak_data(void);
+static void clear_timezone(void);
+static void clear_wifi_fast_cache(void);
+static void wifi_power_acquire(void);
+static void wifi_power_release(void);
+#if WIFI_DUTY_CYCLE
+static void wifi_start(void);
+static bool wifi_wait_connected(void);
+static void wifi_shut_down(void);
+static void schedule_wifi_resync(void);
+static void resync_clock(void);
+#endif
+#ifdef DEEP_SLEEP_MODE
+static void record_wake_to_webhook(int64_t delivered_us);
+#endif
 static bool check_hmac_key_available(void);
 static void bytes_to_hex(const uint8_t *bytes, size_t len, char *hex_str);
 static bool calculate_hmac_signature(const char *message, size_t message_len, char *signature_hex);
 
 // ============== UTILITY FUNCTIONS ==============
 
-static uint32_t millis(void) {
-    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+// Copy the string value of "key" out of a flat JSON object. Escapes are not
+// decoded. Returns false if the key is missing or the value doesn't fit.
+static bool json_get_string(const char *json, const char *key, char *out, size_t len) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *start = strstr(json, pattern);
+    if (!start) return false;
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (!end || (size_t)(end - start) >= len) return false;
+    memcpy(out, start, end - start);
+    out[end - start] = '\0';
+    return true;
+}
+
+// Read the unsigned integer value of "key" out of a flat JSON object
+static bool json_get_uint(const char *json, const char *key, uint32_t *out) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *start = strstr(json, pattern);
+    if (!start) return false;
+    start += strlen(pattern);
+    char *end;
+    unsigned long value = strtoul(start, &end, 10);
+    if (end == start) return false;
+    *out = (uint32_t)value;
+    return true;
+}
+
+// Parse exactly len bytes of hex; false on a wrong length or a bad digit
+static bool hex_to_bytes(const char *hex_str, uint8_t *bytes, size_t len) {
+    if (strlen(hex_str) != len * 2) return false;
+    for (size_t i = 0; i < len * 2; i++) {
+        char c = hex_str[i];
+        int nibble = c >= '0' && c <= '9' ? c - '0' :
+                     c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                     c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (nibble < 0) return false;
+        bytes[i / 2] = (uint8_t)((i % 2) ? (bytes[i / 2] | nibble) : (nibble << 4));
+    }
+    return true;
 }
 
 // Convert bytes to hex string
@@ -175,14 +619,65 @@ static bool calculate_hmac_signature(const char *message, size_t message_len, ch
     return true;
 }
 
+// ============== BOOT TIMELINE ==============
+// Each boot stage records when it finished; the table printed at the end
+// of boot makes regressions in any one stage visible
+
+#define BOOT_MAX_MARKS 16
+
+typedef struct {
+    const char *stage;
+    int64_t time_us;
+} boot_mark_t;
+
+static boot_mark_t s_boot_marks[BOOT_MAX_MARKS];
+static int s_boot_mark_count = 0;
+
+static void boot_mark(const char *stage) {
+    if (s_boot_mark_count < BOOT_MAX_MARKS) {
+        s_boot_marks[s_boot_mark_count++] = (boot_mark_t){stage, esp_timer_get_time()};
+    }
+}
+
+static void log_boot_timeline(void) {
+    ESP_LOGI(TAG, "Boot timeline (ms since app start, stage duration):");
+    int64_t prev_us = 0;
+    for (int i = 0; i < s_boot_mark_count; i++) {
+        ESP_LOGI(TAG, "  %8.1f  %+8.1f  %s", s_boot_marks[i].time_us / 1000.0,
+                 (s_boot_marks[i].time_us - prev_us) / 1000.0, s_boot_marks[i].stage);
+        prev_us = s_boot_marks[i].time_us;
+    }
+}
+
 // ============== WIFI EVENT HANDLER ==============
 
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        s_wifi_associated_us = esp_timer_get_time();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAXIMUM_RETRY) {
+        if (!s_wifi_running) {
+            return;  // stopped on purpose
+        } else if (s_wifi_fast_connect) {
+            // The cached AP didn't answer: forget it and scan like a first boot
+            ESP_LOGW(TAG, "Fast reconnect failed after %lld ms - falling back to a full scan",
+                     (long long)((esp_timer_get_time() - s_wifi_connect_start_us) / 1000));
+            s_wifi_fast_connect = false;
+            clear_wifi_fast_cache();
+
+            wifi_config_t wifi_config;
+            esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+            wifi_config.sta.bssid_set = false;
+            wifi_config.sta.channel = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+            if (s_wifi_static_ip) {
+                esp_netif_dhcpc_start(s_sta_netif);
+                s_wifi_static_ip = false;
+            }
+            esp_wifi_connect();
+        } else if (s_retry_num < WIFI_MAXIMUM_RETRY) {
             esp_wifi_connect();
             s_retry_num++;
             ESP_LOGI(TAG, "Retrying WiFi connection...");
@@ -199,70 +694,180 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         if (s_wifi_event_group) {
             xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
         }
+        queue_timezone_lookup();
+        queue_journal_replay();
+        queue_state_sync();
     }
 }
 
 // ============== LED FUNCTIONS ==============
 
-static void setup_leds(void) {
-    gpio_config_t io_conf = {
-        .pin_bit_mask = 0,
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
+// Effects drawn over the streak display by led_task, highest priority
+// wins. Steps are {kind, level, fade_ms, ms}; ms = 0 holds until stopped.
+static const led_step_t RESET_CONFIRM_STEPS[] = {
+    {LED_STEP_FILL, LED_LEVEL_MAX, 0, 200},
+    {LED_STEP_FILL, 0, 0, 200},
+};
+static const led_step_t RESET_COUNTDOWN_STEPS[] = {
+    {LED_STEP_BAR, LED_LEVEL_MAX, 0, RESET_HOLD_TIME_US / 1000},
+    {LED_STEP_FILL, LED_LEVEL_MAX, 0, 0},
+};
+static const led_step_t CONNECTING_STEPS[] = {   // today's LED breathes
+    {LED_STEP_TODAY, LED_LEVEL_MAX, 600, 700},
+    {LED_STEP_TODAY, 0, 600, 700},
+};
+static const led_step_t PROVISIONING_STEPS[] = {
+    {LED_STEP_SWEEP, LED_LEVEL_MAX, 200, 1200},
+};
+static const led_step_t SYNC_FAILED_STEPS[] = {  // the display dips twice
+    {LED_STEP_DIM, 40, 150, 300},
+    {LED_STEP_BASE, 0, 150, 300},
+};
+static const led_step_t PRESS_ACK_STEPS[] = {    // today's LED flares once
+    {LED_STEP_TODAY, LED_LEVEL_MAX, 80, 200},
+    {LED_STEP_BASE, 0, 300, 300},
+};
 
-    for (int i = 0; i < 7; i++) {
-        io_conf.pin_bit_mask |= (1ULL << LED_PINS[i]);
+static const led_pattern_t LED_RESET_CONFIRM = LED_PATTERN(RESET_CONFIRM_STEPS, 50, 3);
+static const led_pattern_t LED_RESET_COUNTDOWN = LED_PATTERN(RESET_COUNTDOWN_STEPS, 40, 0);
+static const led_pattern_t LED_CONNECTING = LED_PATTERN(CONNECTING_STEPS, 30, 0);
+static const led_pattern_t LED_PROVISIONING = LED_PATTERN(PROVISIONING_STEPS, 20, 0);
+static const led_pattern_t LED_SYNC_FAILED = LED_PATTERN(SYNC_FAILED_STEPS, 10, 2);
+static const led_pattern_t LED_PRESS_ACK = LED_PATTERN(PRESS_ACK_STEPS, 10, 1);
+// Frame-timed: wakes for the next frame only while a pattern is moving,
+// otherwise when a pattern starts or stops or the streak changes
+static void led_task(void *pvParameters) {
+    while (true) {
+        uint8_t frame[LED_COUNT];
+        bool animating;
+        xSemaphoreTake(s_led_mutex, portMAX_DELAY);
+        int64_t now_us = esp_timer_get_time();
+        int64_t next_us = led_anim_render(&s_led_anim, now_us, s_led_base, frame, LED_COUNT, &animating);
+        xSemaphoreGive(s_led_mutex);
+
+        // The driver's fade smooths animation frames; the streak crossfades
+        led_driver_show(frame, animating ? LED_ANIM_FRAME_MS : LED_FADE_MS);
+
+        TickType_t wait = portMAX_DELAY;
+        if (next_us != LED_ANIM_NO_DEADLINE) {
+            wait = next_us > now_us ? pdMS_TO_TICKS((next_us - now_us + 999) / 1000) : 0;
+            if (wait == 0) wait = 1;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
     }
-    gpio_config(&io_conf);
+}
 
-    for (int i = 0; i < 7; i++) {
-        gpio_set_level(LED_PINS[i], 0);
-    }
+static void setup_leds(void) {
+    led_driver_init(LED_PINS);
+    led_driver_set_brightness(LED_BRIGHTNESS);
+    led_anim_init(&s_led_anim);
+    s_led_mutex = xSemaphoreCreateMutex();
+    xTaskCreate(led_task, "leds", LED_TASK_STACK_SIZE, NULL, 8, &s_led_task);
 }
 
+// Render the newest days of the press history as the base display. Takes
+// no state lock: callers hold it once the button task is running.
 static void update_leds(void) {
-    for (int i = 0; i < 7; i++) {
-        bool state = (streak_data >> i) & 1;
-        gpio_set_level(LED_PINS[i], state ? 1 : 0);
+    uint8_t levels[LED_COUNT];
+    for (int i = 0; i < LED_COUNT; i++) {
+        int32_t days_ago = (int32_t)(LED_COUNT - 1 - i) * LED_DAYS_PER_LED;
+        int pressed = 0;
+        for (int d = 0; d < LED_DAYS_PER_LED; d++) {
+            pressed += press_history_get(&s_history, days_ago + d, NULL);
+        }
+        levels[i] = (uint8_t)(pressed * LED_LEVEL_MAX / LED_DAYS_PER_LED);
     }
+
+    xSemaphoreTake(s_led_mutex, portMAX_DELAY);
+    memcpy(s_led_base, levels, sizeof(s_led_base));
+    xSemaphoreGive(s_led_mutex);
+    xTaskNotifyGive(s_led_task);
 }
 
-static void animate_leds(void) {
-    uint32_t now = millis();
-    if (now - last_animation_time >= ANIMATION_INTERVAL) {
-        last_animation_time = now;
+// Start a pattern over the streak display, or restart it if running
+static void leds_play(const led_pattern_t *pattern) {
+    xSemaphoreTake(s_led_mutex, portMAX_DELAY);
+    bool started = led_anim_start(&s_led_anim, pattern, esp_timer_get_time());
+    xSemaphoreGive(s_led_mutex);
+    if (!started) {
+        ESP_LOGW(TAG, "LED pattern dropped - %d already running", LED_ANIM_MAX_ACTIVE);
+    }
+    xTaskNotifyGive(s_led_task);
+}
 
-        for (int i = 0; i < 7; i++) {
-            gpio_set_level(LED_PINS[i], 0);
-        }
+static void leds_stop(const led_pattern_t *pattern) {
+    xSemaphoreTake(s_led_mutex, portMAX_DELAY);
+    led_anim_stop(&s_led_anim, pattern);
+    xSemaphoreGive(s_led_mutex);
+    xTaskNotifyGive(s_led_task);
+}
 
-        int led_index;
-        int cycle = animation_index % 12;
-        if (cycle < 7) {
-            led_index = cycle;
-        } else {
-            led_index = 12 - cycle;
-        }
+// Sleep until a pattern that plays a set number of times has finished
+static void leds_wait(const led_pattern_t *pattern) {
+    xSemaphoreTake(s_led_mutex, portMAX_DELAY);
+    int64_t end_us = led_anim_end_us(&s_led_anim, pattern);
+    xSemaphoreGive(s_led_mutex);
 
-        gpio_set_level(LED_PINS[led_index], 1);
-        animation_index++;
+    int64_t now_us = esp_timer_get_time();
+    if (end_us != LED_ANIM_NO_DEADLINE && end_us > now_us) {
+        vTaskDelay(pdMS_TO_TICKS((end_us - now_us + 999) / 1000) + 1);
     }
 }
 
+// Dim at night. Runs whenever the clock is reconciled and from the
+// periodic power stats tick, so the change lands within 10 minutes.
+static void update_led_brightness(void) {
+    if (!clock_valid()) return;
+
+    int hour = get_current_minute() / 60;
+    bool night = LED_NIGHT_START_HOUR > LED_NIGHT_END_HOUR
+        ? (hour >= LED_NIGHT_START_HOUR || hour < LED_NIGHT_END_HOUR)
+        : (hour >= LED_NIGHT_START_HOUR && hour < LED_NIGHT_END_HOUR);
+    led_driver_set_brightness(night ? LED_NIGHT_BRIGHTNESS : LED_BRIGHTNESS);
+}
+
 // ============== BUTTON HANDLING ==============
 
+static void lock_state(void) {
+    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+}
+
+static void unlock_state(void) {
+    xSemaphoreGive(s_state_mutex);
+}
+
+// Timestamp every edge and hand it to button_task; no debouncing in the ISR.
+// The pins use level interrupts, which unlike edge interrupts can also wake
+// the chip from light sleep. Re-arming for the opposite level makes each one
+// fire once per level change, just like an edge interrupt.
+static void IRAM_ATTR button_isr_handler(void *arg) {
+    gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
+    button_edge_t edge = {
+        .pin = pin,
+        .level = gpio_get_level(pin),
+        .time_us = esp_timer_get_time(),
+    };
+    gpio_ll_set_intr_type(&GPIO, pin, edge.level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+
+    BaseType_t higher_priority_woken = pdFALSE;
+    xQueueSendFromISR(s_button_queue, &edge, &higher_priority_woken);
+    if (higher_priority_woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Both buttons are active low and wake the chip from light sleep when pressed
 static void setup_button(void) {
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << BUTTON_PIN),
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
+        .intr_type = GPIO_INTR_LOW_LEVEL,
     };
     gpio_config(&io_conf);
+    gpio_sleep_sel_dis(BUTTON_PIN);
+    gpio_wakeup_enable(BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
 }
 
 // Setup boot button GPIO
@@ -272,306 +877,749 @@ static void setup_boot_button(void) {
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
+        .intr_type = GPIO_INTR_LOW_LEVEL,
     };
     gpio_config(&io_conf);
+    gpio_sleep_sel_dis(BOOT_BUTTON_PIN);
+    gpio_wakeup_enable(BOOT_BUTTON_PIN, GPIO_INTR_LOW_LEVEL);
 }
 
-// State for boot button hold detection
-static uint32_t boot_button_hold_start = 0;
-static bool boot_button_was_pressed = false;
+// Boot button held: show progress and trigger factory reset after 5 seconds
+static void update_boot_hold(int64_t now_us) {
+    static int last_seconds_remaining = -1;
+
+    if (!button_debounce_is_pressed(&s_boot_db)) {
+        last_seconds_remaining = -1;
+        return;
+    }
 
-// Check boot button state - call this from main loop
-// Triggers factory reset if held for 5 seconds
-static void check_boot_button(void) {
-    const uint32_t RESET_HOLD_TIME_MS = 5000;
+    int64_t elapsed = button_debounce_held_us(&s_boot_db, now_us);
 
-    bool is_pressed = (gpio_get_level(BOOT_BUTTON_PIN) == 0);
+    // Log countdown every second
+    int seconds_remaining = (int)((RESET_HOLD_TIME_US - elapsed + 999999) / 1000000);
+    if (seconds_remaining != last_seconds_remaining && seconds_remaining > 0 && seconds_remaining <= 5) {
+        ESP_LOGI(TAG, "Resetting in %ds...", seconds_remaining);
+        last_seconds_remaining = seconds_remaining;
+    }
 
-    if (is_pressed && !boot_button_was_pressed) {
-        // Button just pressed
-        boot_button_hold_start = millis();
-        boot_button_was_pressed = true;
+    // Check if held long enough
+    if (elapsed >= RESET_HOLD_TIME_US) {
+        ESP_LOGW(TAG, "Factory reset triggered by BOOT button!");
+
+        // Flash all LEDs 3 times to confirm while the data is cleared
+        leds_stop(&LED_RESET_COUNTDOWN);
+        leds_play(&LED_RESET_CONFIRM);
+
+        // Clear all data
+        clear_wifi_credentials();
+        clear_streak_data();
+        clear_timezone();
+
+        ESP_LOGI(TAG, "Factory reset complete - restarting...");
+        leds_wait(&LED_RESET_CONFIRM);
+        esp_restart();
+    }
+}
+
+static void on_boot_button_event(button_event_t event) {
+    if (event == BUTTON_EVENT_PRESS) {
         ESP_LOGI(TAG, "BOOT button pressed - hold for 5 seconds to factory reset...");
-    } else if (!is_pressed && boot_button_was_pressed) {
-        // Button released
-        boot_button_was_pressed = false;
+        leds_play(&LED_RESET_COUNTDOWN);
+    } else if (event == BUTTON_EVENT_RELEASE) {
         ESP_LOGI(TAG, "BOOT button released - reset cancelled");
-        // Restore LEDs
-        update_leds();
-    } else if (is_pressed && boot_button_was_pressed) {
-        // Button still held
-        uint32_t elapsed = millis() - boot_button_hold_start;
-
-        // Log countdown every second
-        static int last_seconds_remaining = -1;
-        int seconds_remaining = (RESET_HOLD_TIME_MS - elapsed + 999) / 1000;
-        if (seconds_remaining != last_seconds_remaining && seconds_remaining > 0 && seconds_remaining <= 5) {
-            ESP_LOGI(TAG, "Resetting in %ds...", seconds_remaining);
-            last_seconds_remaining = seconds_remaining;
-        }
-
-        // Visual feedback: light up LEDs progressively
-        int leds_to_light = (elapsed * 7) / RESET_HOLD_TIME_MS;
-        if (leds_to_light > 7) leds_to_light = 7;
-        for (int i = 0; i < 7; i++) {
-            gpio_set_level(LED_PINS[i], i < leds_to_light ? 1 : 0);
-        }
+        leds_stop(&LED_RESET_COUNTDOWN);
+    }
+}
 
-        // Check if held long enough
-        if (elapsed >= RESET_HOLD_TIME_MS) {
-            ESP_LOGW(TAG, "Factory reset triggered by BOOT button!");
-
-            // Flash all LEDs 3 times to confirm
-            for (int flash = 0; flash < 3; flash++) {
-                for (int i = 0; i < 7; i++) {
-                    gpio_set_level(LED_PINS[i], 1);
-                }
-                vTaskDelay(pdMS_TO_TICKS(200));
-                for (int i = 0; i < 7; i++) {
-                    gpio_set_level(LED_PINS[i], 0);
-                }
-                vTaskDelay(pdMS_TO_TICKS(200));
-            }
+static void on_button_event(gpio_num_t pin, button_event_t event) {
+    if (event == BUTTON_EVENT_NONE) return;
 
-            // Clear all data
-            clear_wifi_credentials();
-            clear_streak_data();
+#ifdef DEEP_SLEEP_MODE
+    s_last_input_us = esp_timer_get_time();
+    xEventGroupSetBits(s_app_events, APP_BUTTON_BIT);
+#endif
 
-            ESP_LOGI(TAG, "Factory reset complete - restarting...");
-            vTaskDelay(pdMS_TO_TICKS(500));
-            esp_restart();
+    if (pin == BUTTON_PIN) {
+        if (event == BUTTON_EVENT_PRESS) {
+            on_button_press();
         }
     } else {
-        // Reset countdown display state when button not pressed
-        static int last_seconds_remaining = -1;
-        last_seconds_remaining = -1;
+        on_boot_button_event(event);
+    }
+}
+
+static void on_button_press(void) {
+    lock_state();
+    bool state = toggle_today();
+    update_leds();
+    schedule_streak_save();
+    uint8_t data = s_streak.bits;
+    // Until the clock is synced "today" may be a stale day;
+    // align_streak_to_clock() moves these presses to the right one
+    bool aligned = s_streak_aligned;
+    if (!aligned) s_early_toggles++;
+    unlock_state();
+
+    if (aligned) {
+        queue_press_event(state);
     }
+
+    ESP_LOGI(TAG, "Today toggled: %s | Streak: %d%d%d%d%d%d%d",
+             state ? "ON" : "OFF",
+             (data >> 6) & 1, (data >> 5) & 1,
+             (data >> 4) & 1, (data >> 3) & 1,
+             (data >> 2) & 1, (data >> 1) & 1,
+             data & 1);
 }
 
-static void handle_button(void) {
-    bool reading = gpio_get_level(BUTTON_PIN);
+// How long button_task may block: until the next debounce deadline, or
+// periodically while BOOT is held so the countdown log and the reset fire on time
+static TickType_t button_task_timeout(int64_t now_us) {
+    int64_t wake_us = -1;
+    int64_t deadlines[] = {
+        button_debounce_deadline(&s_button_db),
+        button_debounce_deadline(&s_boot_db),
+    };
+    for (int i = 0; i < 2; i++) {
+        if (deadlines[i] != BUTTON_DEBOUNCE_NO_DEADLINE && (wake_us < 0 || deadlines[i] < wake_us)) {
+            wake_us = deadlines[i];
+        }
+    }
+
+    if (button_debounce_is_pressed(&s_boot_db)) {
+        int64_t refresh_us = now_us + BOOT_HOLD_REFRESH_MS * 1000;
+        if (wake_us < 0 || refresh_us < wake_us) {
+            wake_us = refresh_us;
+        }
+    }
 
-    if (reading != last_button_state) {
-        last_debounce_time = millis();
+    if (wake_us < 0) {
+        return portMAX_DELAY;
+    }
+    if (wake_us <= now_us) {
+        return 0;
     }
+    return pdMS_TO_TICKS((wake_us - now_us + 999) / 1000) + 1;
+}
 
-    if ((millis() - last_debounce_time) > DEBOUNCE_DELAY) {
-        if (reading == 0 && !button_pressed) {
-            button_pressed = true;
-            today_state = !today_state;
+// Consumes ISR edges, debounces them and dispatches press/release gestures
+static void button_task(void *pvParameters) {
+    button_edge_t edge;
 
-            if (today_state) {
-                streak_data |= (1 << 6);
-            } else {
-                streak_data &= ~(1 << 6);
-            }
+    while (true) {
+        TickType_t timeout = button_task_timeout(esp_timer_get_time());
 
-            update_leds();
-            save_streak();
-            send_webhook(today_state);
-
-            ESP_LOGI(TAG, "Today toggled: %s | Streak: %d%d%d%d%d%d%d",
-                     today_state ? "ON" : "OFF",
-                     (streak_data >> 6) & 1, (streak_data >> 5) & 1,
-                     (streak_data >> 4) & 1, (streak_data >> 3) & 1,
-                     (streak_data >> 2) & 1, (streak_data >> 1) & 1,
-                     streak_data & 1);
-        } else if (reading == 1) {
-            button_pressed = false;
+        if (xQueueReceive(s_button_queue, &edge, timeout) == pdTRUE) {
+            button_debounce_t *db = (edge.pin == BUTTON_PIN) ? &s_button_db : &s_boot_db;
+            on_button_event(edge.pin, button_debounce_poll(db, edge.time_us));
+            on_button_event(edge.pin, button_debounce_edge(db, edge.level, edge.time_us));
         }
+
+        int64_t now = esp_timer_get_time();
+        on_button_event(BUTTON_PIN, button_debounce_poll(&s_button_db, now));
+        on_button_event(BOOT_BUTTON_PIN, button_debounce_poll(&s_boot_db, now));
+        update_boot_hold(now);
     }
+}
 
-    last_button_state = reading;
+static void start_button_task(void) {
+    button_debounce_init(&s_button_db, 0, DEBOUNCE_DELAY_US);
+    button_debounce_init(&s_boot_db, 0, DEBOUNCE_DELAY_US);
+
+    s_button_queue = xQueueCreate(BUTTON_QUEUE_LENGTH, sizeof(button_edge_t));
+    xTaskCreate(button_task, "button", 4096, NULL, 10, NULL);
+
+#ifdef DEEP_SLEEP_MODE
+    if (s_wake_cause == ESP_SLEEP_WAKEUP_EXT1) {
+        // The press that woke us happened before the ISR existed: count it
+        // now and wait for the release, which may already have happened
+        button_debounce_edge(&s_button_db, 0, 0);
+        gpio_set_intr_type(BUTTON_PIN, GPIO_INTR_HIGH_LEVEL);
+        on_button_press();
+        s_last_input_us = esp_timer_get_time();
+    }
+#endif
+
+    ESP_ERROR_CHECK(gpio_install_isr_service(0));
+    gpio_isr_handler_add(BUTTON_PIN, button_isr_handler, (void *)(intptr_t)BUTTON_PIN);
+    gpio_isr_handler_add(BOOT_BUTTON_PIN, button_isr_handler, (void *)(intptr_t)BOOT_BUTTON_PIN);
 }
 
 // ============== TIME & MIDNIGHT ROLLOVER ==============
 
-static char tz_response_buffer[128];
-static int tz_response_len = 0;
+static bool clock_valid(void) {
+    return s_clock_source != CLOCK_SOURCE_NONE;
+}
 
-static esp_err_t tz_http_event_handler(esp_http_client_event_t *evt) {
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            if (tz_response_len + evt->data_len < sizeof(tz_response_buffer) - 1) {
-                memcpy(tz_response_buffer + tz_response_len, evt->data, evt->data_len);
-                tz_response_len += evt->data_len;
-                tz_response_buffer[tz_response_len] = '\0';
-            }
-            break;
-        default:
-            break;
+static const char *clock_source_name(clock_source_t source) {
+    switch (source) {
+        case CLOCK_SOURCE_RTC: return "RTC";
+        case CLOCK_SOURCE_HTTP: return "HTTP Date";
+        case CLOCK_SOURCE_NTP: return "NTP";
+        default: return "unset";
     }
-    return ESP_OK;
 }
 
-static void fetch_timezone(void) {
-    ESP_LOGI(TAG, "Detecting timezone from IP...");
+static uint32_t clock_checkpoint_check(const clock_checkpoint_t *cp) {
+    return cp->magic ^ cp->source ^ (uint32_t)cp->epoch_us ^ (uint32_t)(cp->epoch_us >> 32) ^
+           (uint32_t)cp->rtc_us ^ (uint32_t)(cp->rtc_us >> 32);
+}
+
+// Pair the current wall clock with the RTC counter, which keeps running
+// through soft resets and deep sleep
+static void save_clock_checkpoint(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    s_clock_checkpoint.epoch_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    s_clock_checkpoint.rtc_us = esp_rtc_get_time_us();
+    s_clock_checkpoint.source = s_clock_source;
+    s_clock_checkpoint.magic = CLOCK_CHECKPOINT_MAGIC;
+    s_clock_checkpoint.check = clock_checkpoint_check(&s_clock_checkpoint);
+}
+
+static void set_clock(int64_t epoch_us, clock_source_t source) {
+    struct timeval tv = {
+        .tv_sec = (time_t)(epoch_us / 1000000),
+        .tv_usec = (suseconds_t)(epoch_us % 1000000),
+    };
+    settimeofday(&tv, NULL);
+
+    bool was_valid = clock_valid();
+    s_clock_source = source;
+    save_clock_checkpoint();
+    if (!was_valid) queue_journal_replay();
+    if (s_app_events) {
+        xEventGroupSetBits(s_app_events, APP_TIME_CHANGED_BIT);
+    }
+}
+
+// Boot: the last known time plus the RTC time elapsed since. The RTC
+// counter only restarts on power-on, which also clears the checkpoint's
+// validity. Returns true if the clock was set.
+static bool restore_clock_checkpoint(void) {
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT ||
+        s_clock_checkpoint.magic != CLOCK_CHECKPOINT_MAGIC ||
+        s_clock_checkpoint.check != clock_checkpoint_check(&s_clock_checkpoint)) {
+        return false;
+    }
+
+    uint64_t rtc_now_us = esp_rtc_get_time_us();
+    if (rtc_now_us < s_clock_checkpoint.rtc_us) return false;
+
+    uint64_t elapsed_us = rtc_now_us - s_clock_checkpoint.rtc_us;
+    set_clock(s_clock_checkpoint.epoch_us + (int64_t)elapsed_us, CLOCK_SOURCE_RTC);
+    ESP_LOGI(TAG, "Clock restored from RTC checkpoint (%s, %llu s ago)",
+             clock_source_name(s_clock_checkpoint.source),
+             (unsigned long long)(elapsed_us / 1000000));
+    return true;
+}
+
+// Any HTTP response carries the server's time. Used until NTP answers,
+// and only when it disagrees with the clock by more than its resolution.
+static void apply_http_date_header(const char *key, const char *value) {
+    if (s_clock_source == CLOCK_SOURCE_NTP || !key || !value || strcasecmp(key, "Date") != 0) {
+        return;
+    }
+
+    int64_t server_s;
+    if (!parse_http_date(value, &server_s)) return;
+
+    // The header is truncated to the second; assume the middle of it
+    int64_t server_us = server_s * 1000000 + 500000;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t offset_us = server_us - ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+    if (clock_valid() && llabs(offset_us) <= (int64_t)HTTP_DATE_TOLERANCE_S * 1000000) return;
+
+    ESP_LOGI(TAG, "Clock set from HTTP Date header (%s, off by %lld ms)", value,
+             clock_valid() ? (long long)(offset_us / 1000) : 0LL);
+    set_clock(server_us, CLOCK_SOURCE_HTTP);
+}
+
+static esp_err_t clock_probe_http_event_handler(esp_http_client_event_t *evt) {
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        apply_http_date_header(evt->header_key, evt->header_value);
+    }
+    return ESP_OK;
+}
 
-    tz_response_len = 0;
-    tz_response_buffer[0] = '\0';
+// After a power-on reset there is no checkpoint to restore. A HEAD request
+// to the backend answers with its Date header, usually before SNTP does.
+static void probe_clock(void) {
+    if (clock_valid()) return;
 
     esp_http_client_config_t config = {
-        .url = "http://ip-api.com/json/?fields=offset",
-        .timeout_ms = 10000,
-        .event_handler = tz_http_event_handler,
+        .url = WEBHOOK_BASE_URL "/",
+        .method = HTTP_METHOD_HEAD,
+        .timeout_ms = WEBHOOK_TIMEOUT_MS,
+        .event_handler = clock_probe_http_event_handler,
+#ifndef CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
     };
     esp_http_client_handle_t client = esp_http_client_init(&config);
 
+    wifi_power_acquire();
     esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Timezone API response: %d, body: %s", status, tz_response_buffer);
-        if (status == 200 && tz_response_len > 0) {
-            // Response format: {"offset":-25200}
-            char *offset_str = strstr(tz_response_buffer, "\"offset\":");
-            if (offset_str) {
-                gmt_offset_sec = atol(offset_str + 9);  // Skip past "offset":
-                ESP_LOGI(TAG, "Detected timezone offset: %ld seconds (UTC%+.1f)",
-                         gmt_offset_sec, gmt_offset_sec / 3600.0);
-            }
-        }
-    } else {
-        ESP_LOGW(TAG, "Timezone detection failed: %s", esp_err_to_name(err));
+    wifi_power_release();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Clock probe failed: %s", esp_err_to_name(err));
+    } else if (!clock_valid()) {
+        ESP_LOGW(TAG, "Clock probe response had no usable Date header");
     }
     esp_http_client_cleanup(client);
 }
 
-static void time_sync_notification_cb(struct timeval *tv) {
-    ESP_LOGI(TAG, "NTP time synchronized");
-    ntp_synced = true;
+// Printable ASCII only; newlib quietly treats anything it can't parse as UTC
+static bool timezone_rule_valid(const char *tz) {
+    size_t len = strnlen(tz, TZ_MAX_LEN);
+    if (len == 0 || len >= TZ_MAX_LEN) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (tz[i] <= ' ' || tz[i] > '~' || tz[i] == '"' || tz[i] == '\\') return false;
+    }
+    return true;
 }
 
-static void sync_ntp(void) {
-    fetch_timezone();
+static void set_timezone(const char *tz) {
+    if (tz != s_tz) {
+        strlcpy(s_tz, tz, sizeof(s_tz));
+    }
+    setenv("TZ", s_tz, 1);
+    tzset();
+}
 
-    ESP_LOGI(TAG, "Syncing time with NTP server: %s", NTP_SERVER);
+static void load_timezone(void) {
+    nvs_handle_t nvs;
+    if (nvs_open("time", NVS_READONLY, &nvs) == ESP_OK) {
+        size_t len = sizeof(s_tz);
+        s_tz_stored = nvs_get_str(nvs, "tz", s_tz, &len) == ESP_OK && timezone_rule_valid(s_tz);
+        if (!s_tz_stored) {
+            strlcpy(s_tz, TZ_DEFAULT, sizeof(s_tz));
+        }
+        nvs_close(nvs);
+    }
+    set_timezone(s_tz);
+    ESP_LOGI(TAG, "Time zone: %s", s_tz);
+}
 
-    // Configure SNTP
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, NTP_SERVER);
-    esp_sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-    esp_sntp_init();
+// Store and apply a new zone; the main loop re-reads local time
+static void update_timezone(const char *tz) {
+    if (!timezone_rule_valid(tz)) {
+        ESP_LOGW(TAG, "Ignoring invalid time zone rule");
+        return;
+    }
+    if (strcmp(tz, s_tz) == 0 && s_tz_stored) return;
 
-    ESP_LOGI(TAG, "SNTP initialized, waiting for sync...");
+    set_timezone(tz);
+    nvs_handle_t nvs;
+    if (nvs_open("time", NVS_READWRITE, &nvs) == ESP_OK) {
+        s_tz_stored = nvs_set_str(nvs, "tz", s_tz) == ESP_OK && nvs_commit(nvs) == ESP_OK;
+        nvs_close(nvs);
+    }
+    ESP_LOGI(TAG, "Time zone changed to %s", s_tz);
+    if (s_app_events) {
+        xEventGroupSetBits(s_app_events, APP_TIME_CHANGED_BIT);
+    }
+}
 
-    // Wait for sync using our callback flag
-    int attempts = 0;
-    while (!ntp_synced && attempts < 30) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+static char s_tz_lookup_buffer[64];
+static int s_tz_lookup_len = 0;
 
-        // Check SNTP status for debugging
-        sntp_sync_status_t status = sntp_get_sync_status();
-        ESP_LOGI(TAG, "Waiting for NTP sync... (status: %d, attempt %d/30)", status, attempts + 1);
-        attempts++;
+static esp_err_t tz_lookup_http_event_handler(esp_http_client_event_t *evt) {
+    if (evt->event_id == HTTP_EVENT_ON_DATA &&
+        s_tz_lookup_len + evt->data_len < (int)sizeof(s_tz_lookup_buffer)) {
+        memcpy(s_tz_lookup_buffer + s_tz_lookup_len, evt->data, evt->data_len);
+        s_tz_lookup_len += evt->data_len;
+        s_tz_lookup_buffer[s_tz_lookup_len] = '\0';
     }
+    return ESP_OK;
+}
+
+// Firmware from before the rule was stored looked the UTC offset up by IP
+// on every boot, so a device updated in place has no rule and would roll
+// its day over at UTC midnight. Look the offset up once more and store it
+// as a fixed rule; a rule set in the web app replaces it with the next
+// response. Tried once per boot (and not again on deep-sleep wakes),
+// whatever the outcome.
+static void lookup_legacy_timezone(void) {
+    if (s_tz_stored || s_tz_lookup_tried) return;
+    s_tz_lookup_tried = true;
+
+    s_tz_lookup_len = 0;
+    s_tz_lookup_buffer[0] = '\0';
+    esp_http_client_config_t config = {
+        .url = TZ_LOOKUP_URL,
+        .timeout_ms = WEBHOOK_TIMEOUT_MS,
+        .event_handler = tz_lookup_http_event_handler,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
 
-    if (ntp_synced) {
-        setenv("TZ", "UTC", 1);
-        tzset();
+    wifi_power_acquire();
+    esp_err_t err = esp_http_client_perform(client);
+    wifi_power_release();
+    int status = err == ESP_OK ? esp_http_client_get_status_code(client) : -1;
+    esp_http_client_cleanup(client);
 
-        time_t now;
-        struct tm timeinfo;
-        time(&now);
-        now += gmt_offset_sec;
-        localtime_r(&now, &timeinfo);
+    // Response format: {"offset":-25200}
+    const char *field = strstr(s_tz_lookup_buffer, "\"offset\":");
+    char rule[TZ_MAX_LEN];
+    if (status != 200 || !field ||
+        !timezone_rule_from_offset(strtol(field + 9, NULL, 10), rule, sizeof(rule))) {
+        ESP_LOGW(TAG, "Time zone lookup failed (status %d) - staying on %s", status, s_tz);
+        return;
+    }
+    ESP_LOGI(TAG, "No stored time zone - using %s from the IP's UTC offset", rule);
+    update_timezone(rule);
+}
 
-        last_day = timeinfo.tm_yday;
-        ESP_LOGI(TAG, "Time synced! Current time: %02d:%02d:%02d",
-                 timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+static void time_sync_notification_cb(struct timeval *tv) {
+    ESP_LOGI(TAG, "NTP time synchronized (was %s)", clock_source_name(s_clock_source));
+    ntp_synced = true;
+    s_clock_source = CLOCK_SOURCE_NTP;
+    save_clock_checkpoint();
+    s_ntp_backoff_s = NTP_RETRY_MIN_S;
+    s_ntp_retry_us = esp_timer_get_time() + (int64_t)NTP_STALE_S * 1000000;
+#ifdef DEEP_SLEEP_MODE
+    s_rtc_state.last_sync = tv->tv_sec;
+#endif
+    queue_journal_replay();
+    if (s_app_events) {
+        xEventGroupSetBits(s_app_events, APP_TIME_CHANGED_BIT | APP_NTP_SYNCED_BIT);
+    }
+}
 
-        nvs_handle_t nvs;
-        if (nvs_open("streak", NVS_READONLY, &nvs) == ESP_OK) {
-            int32_t saved_day = -1;
-            nvs_get_i32(nvs, "lastDay", &saved_day);
-            nvs_close(nvs);
+// Configure SNTP once the network stack exists but before WiFi connects,
+// so the DHCP lease can supply an NTP server
+static void init_time_sync(void) {
+    static bool initialized = false;
+    if (initialized) return;
+    initialized = true;
+
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG_MULTIPLE(2,
+                                   ESP_SNTP_SERVER_LIST(NTP_SERVER, NTP_SERVER_2));
+    config.start = false;
+    config.wait_for_sync = false;
+    config.server_from_dhcp = true;
+    config.renew_servers_after_new_IP = true;
+    config.ip_event_to_renew = IP_EVENT_STA_GOT_IP;
+    config.index_of_first_server = 1;  // index 0 is the DHCP-provided server
+    config.sync_cb = time_sync_notification_cb;
+    ESP_ERROR_CHECK(esp_netif_sntp_init(&config));
+}
 
-            if (saved_day != -1 && saved_day != last_day) {
-                int days_passed = last_day - saved_day;
-                if (days_passed < 0) days_passed += 365;
+// Start SNTP without waiting for it, and probe the backend's Date header
+// if the clock is still unset. Both report back through
+// APP_TIME_CHANGED_BIT, and reconcile_clock() shifts the streak.
+static void start_time_sync(void) {
+    ESP_LOGI(TAG, "Starting time sync (DHCP NTP server, then %s, %s)", NTP_SERVER, NTP_SERVER_2);
+
+    if (!clock_valid()) {
+        net_event_t event = {
+            .type = NET_EVENT_CLOCK_PROBE,
+            .queued_us = esp_timer_get_time(),
+        };
+        xQueueSend(s_net_queue, &event, 0);
+    }
 
-                ESP_LOGI(TAG, "Days since last use: %d", days_passed);
-                for (int i = 0; i < days_passed && i < 7; i++) {
-                    shift_streak();
-                }
-                save_streak();
-            }
-        }
-    } else {
-        ESP_LOGW(TAG, "Failed to sync time - using saved state");
+    esp_netif_sntp_start();
+    s_ntp_backoff_s = NTP_RETRY_MIN_S;
+    s_ntp_retry_us = esp_timer_get_time() + (int64_t)NTP_RETRY_MIN_S * 1000000;
+}
+
+// Called by the network task when no sync arrived in time
+static void retry_time_sync(void) {
+#if WIFI_DUTY_CYCLE
+    if (!s_wifi_running) {
+        s_ntp_retry_us = 0;  // resync_clock() takes over while the radio is off
+        return;
     }
+#endif
+    ESP_LOGW(TAG, "%s - restarting SNTP, next retry in %lu s",
+             ntp_synced ? "No NTP sync for a while" : "Time not synced yet",
+             (unsigned long)s_ntp_backoff_s);
+    esp_sntp_restart();
+    s_ntp_retry_us = esp_timer_get_time() + (int64_t)s_ntp_backoff_s * 1000000;
+    s_ntp_backoff_s = s_ntp_backoff_s * 2 > NTP_RETRY_MAX_S ? NTP_RETRY_MAX_S : s_ntp_backoff_s * 2;
+}
+
+// Caller holds the state lock. Presses made before the clock is aligned
+// are recorded without a time of day.
+static bool toggle_today(void) {
+    bool state = streak_toggle_today(&s_streak);
+    s_history_rev++;
+    press_history_set(&s_history, 0, state,
+                      s_streak_aligned ? get_current_minute() : PRESS_HISTORY_NO_MINUTE);
+    return state;
+}
+
+// Caller holds the state lock
+static int32_t advance_streak(int32_t today) {
+    press_history_advance(&s_history, today);
+    return streak_advance(&s_streak, today);
 }
 
-static int get_current_day(void) {
+// Shift the streak to the synced date, then apply presses made before the
+// sync to today and send them
+static void align_streak_to_clock(void) {
     time_t now;
     struct tm timeinfo;
     time(&now);
-    now += gmt_offset_sec;
     localtime_r(&now, &timeinfo);
-    return timeinfo.tm_yday;
+    int32_t today = days_from_civil(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
+
+    lock_state();
+    // Take back presses made before the sync; they belong to today
+    bool early_toggle = s_early_toggles & 1;
+    if (early_toggle) toggle_today();
+
+    ESP_LOGI(TAG, "Time synced! Current time: %02d:%02d:%02d",
+             timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+
+    if (s_streak.day == STREAK_NO_DAY && s_legacy_yday >= 0) {
+        s_streak.day = streak_day_from_yday(s_legacy_yday, today);
+    }
+    s_legacy_yday = -1;
+    if (s_streak.day != STREAK_NO_DAY && s_streak.day > today) {
+        // Saved under a clock that ran ahead; the bits can't be placed
+        ESP_LOGW(TAG, "Streak day %ld is ahead of today, keeping bits as today's",
+                 (long)s_streak.day);
+        s_streak.day = today;
+    }
+    s_history.day = s_streak.day;
+
+    int32_t days_passed = advance_streak(today);
+    if (days_passed > 0) {
+        ESP_LOGI(TAG, "Days since last use: %ld", (long)days_passed);
+    }
+
+    if (early_toggle) toggle_today();
+    update_leds();
+    schedule_streak_save();
+    bool state = streak_today(&s_streak);
+    uint32_t early_toggles = s_early_toggles;
+    s_early_toggles = 0;
+    s_streak_aligned = true;
+    unlock_state();
+
+    if (early_toggles > 0) {
+        ESP_LOGI(TAG, "Applied %lu presses made before time sync", (unsigned long)early_toggles);
+        if (early_toggle) queue_press_event(state);
+    }
+}
+
+// Main task, whenever the clock or time zone changed
+static void reconcile_clock(void) {
+    if (!clock_valid()) return;
+
+    if (!s_streak_aligned) {
+        align_streak_to_clock();
+        queue_state_sync();
+        boot_mark("clock ready");
+        log_boot_timeline();
+    }
+    check_midnight_rollover();
+    arm_midnight_timer();
+    update_led_brightness();
 }
 
+// Catch the streak up to the local date in one shift, however many
+// midnights passed. A clock that stepped back leaves it alone.
 static void check_midnight_rollover(void) {
-    if (!ntp_synced) return;
+    if (!clock_valid()) return;
 
-    int current_day = get_current_day();
-    if (current_day == -1) return;
+    int32_t today = get_current_epoch_day();
 
-    if (last_day != -1 && current_day != last_day) {
-        ESP_LOGI(TAG, "Midnight! Shifting streak...");
-        shift_streak();
-        save_streak();
-        last_day = current_day;
+    lock_state();
+    int32_t days = advance_streak(today);
+    uint8_t data = s_streak.bits;
+    if (days > 0) {
+        update_leds();
+        schedule_streak_save();
+    }
+    unlock_state();
+
+    if (days > 0) {
+        queue_state_sync();
+        log_flash_write_stats();
+        ESP_LOGI(TAG, "Midnight! Shifted %ld day(s) | Streak: %d%d%d%d%d%d%d", (long)days,
+                 (data >> 6) & 1, (data >> 5) & 1,
+                 (data >> 4) & 1, (data >> 3) & 1,
+                 (data >> 2) & 1, (data >> 1) & 1,
+                 data & 1);
     }
 }
 
-static void shift_streak(void) {
-    streak_data = streak_data >> 1;
-    streak_data &= ~(1 << 6);
-    today_state = false;
-    update_leds();
+static void midnight_timer_cb(void *arg) {
+    xEventGroupSetBits(s_app_events, APP_MIDNIGHT_BIT);
+}
+
+// One-shot at the next local midnight, so nothing polls the clock in
+// between. reconcile_clock() re-arms it after every rollover and every
+// clock step or time zone change. If it fires a little early the rollover
+// check finds the same day and it is simply armed again for the remainder.
+static void arm_midnight_timer(void) {
+    if (!clock_valid()) return;
+
+    if (!s_midnight_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = midnight_timer_cb,
+            .name = "midnight",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&args, &s_midnight_timer));
+    }
 
-    ESP_LOGI(TAG, "Streak after shift: %d%d%d%d%d%d%d",
-             (streak_data >> 6) & 1, (streak_data >> 5) & 1,
-             (streak_data >> 4) & 1, (streak_data >> 3) & 1,
-             (streak_data >> 2) & 1, (streak_data >> 1) & 1,
-             streak_data & 1);
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t delay_us = (int64_t)(next_local_midnight(tv.tv_sec) - tv.tv_sec) * 1000000 - tv.tv_usec;
+    esp_timer_stop(s_midnight_timer);  // fails harmlessly if not running
+    esp_timer_start_once(s_midnight_timer, delay_us);
 }
 
 // ============== PERSISTENCE ==============
 
+// The history is one versioned blob. Older firmware kept only the last
+// seven days as "data", keyed by "epochDay" or, before that, by the day of
+// the year in "lastDay"; those are read once and dropped on the next save.
 static void load_streak(void) {
+    press_history_init(&s_history, STREAK_NO_DAY);
+
     nvs_handle_t nvs;
     if (nvs_open("streak", NVS_READONLY, &nvs) == ESP_OK) {
-        uint8_t data = 0;
-        int32_t day = -1;
-        nvs_get_u8(nvs, "data", &data);
-        nvs_get_i32(nvs, "lastDay", &day);
+        press_history_t *blob = malloc(sizeof(*blob));
+        size_t len = sizeof(*blob);
+        bool loaded = blob && nvs_get_blob(nvs, "history", blob, &len) == ESP_OK &&
+                      press_history_decode(&s_history, blob, len);
+        if (loaded && blob->version == PRESS_HISTORY_VERSION) {
+            s_history_saved = true;
+            s_history_saved_hash = press_history_hash(&s_history);
+        }
+        free(blob);
+
+        if (!loaded) {
+            uint8_t data = 0;
+            int32_t day = STREAK_NO_DAY;
+            nvs_get_u8(nvs, "data", &data);
+            nvs_get_i32(nvs, "epochDay", &day);
+            streak_t legacy;
+            streak_init(&legacy, data, day);
+            press_history_from_streak(&s_history, &legacy);
+        }
+        if (s_history.day == STREAK_NO_DAY) {
+            // A day of the year is turned into a date once the clock is known
+            int32_t yday = -1;
+            nvs_get_i32(nvs, "lastDay", &yday);
+            s_legacy_yday = yday;
+        }
         nvs_close(nvs);
-
-        streak_data = data;
-        last_day = day;
     }
+    s_streak = press_history_streak(&s_history);
+
+    uint8_t bits = s_streak.bits;
+    ESP_LOGI(TAG, "Loaded streak: %d%d%d%d%d%d%d | %d days pressed in the last %d",
+             (bits >> 6) & 1, (bits >> 5) & 1,
+             (bits >> 4) & 1, (bits >> 3) & 1,
+             (bits >> 2) & 1, (bits >> 1) & 1,
+             bits & 1,
+             press_history_count(&s_history, PRESS_HISTORY_DAYS), PRESS_HISTORY_DAYS);
+}
 
-    today_state = (streak_data >> 6) & 1;
+static void streak_save_timer_cb(void *arg) {
+    xEventGroupSetBits(s_app_events, APP_STREAK_SAVE_BIT);
+}
 
-    ESP_LOGI(TAG, "Loaded streak: %d%d%d%d%d%d%d",
-             (streak_data >> 6) & 1, (streak_data >> 5) & 1,
-             (streak_data >> 4) & 1, (streak_data >> 3) & 1,
-             (streak_data >> 2) & 1, (streak_data >> 1) & 1,
-             streak_data & 1);
+// Caller holds the state lock. The commit follows within
+// STREAK_SAVE_DELAY_MS, see flush_streak().
+static void schedule_streak_save(void) {
+    s_streak_dirty = true;
+
+    if (!s_streak_save_timer) {
+        const esp_timer_create_args_t args = {
+            .callback = streak_save_timer_cb,
+            .name = "streak_save",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&args, &s_streak_save_timer));
+    }
+    if (!esp_timer_is_active(s_streak_save_timer)) {
+        esp_timer_start_once(s_streak_save_timer, (int64_t)STREAK_SAVE_DELAY_MS * 1000);
+    }
 }
 
-static void save_streak(void) {
-    nvs_handle_t nvs;
-    if (nvs_open("streak", NVS_READWRITE, &nvs) == ESP_OK) {
-        nvs_set_u8(nvs, "data", streak_data);
-        if (last_day != -1) {
-            nvs_set_i32(nvs, "lastDay", last_day);
+// Commit the history if it differs from the stored blob. Runs on the main
+// task when the save delay elapses, and as the shutdown handler and before
+// deep sleep to force it out.
+static void flush_streak(void) {
+    press_history_t *snapshot = malloc(sizeof(*snapshot));
+    if (!snapshot) return;
+
+    lock_state();
+    bool dirty = s_streak_dirty;
+    uint32_t hash = 0;
+    if (dirty) {
+        *snapshot = s_history;
+        s_streak_dirty = false;
+        hash = press_history_hash(snapshot);
+        if (s_history_saved && hash == s_history_saved_hash) {
+            dirty = false;  // changed back to what is stored
         }
-        nvs_commit(nvs);
-        nvs_close(nvs);
     }
+    unlock_state();
+
+    if (dirty) {
+        nvs_handle_t nvs;
+        esp_err_t err = nvs_open("streak", NVS_READWRITE, &nvs);
+        if (err == ESP_OK) {
+            err = nvs_set_blob(nvs, "history", snapshot, sizeof(*snapshot));
+            if (err == ESP_OK && snapshot->day != STREAK_NO_DAY) {
+                // Fail harmlessly once migrated
+                nvs_erase_key(nvs, "data");
+                nvs_erase_key(nvs, "epochDay");
+                nvs_erase_key(nvs, "lastDay");
+            }
+            if (err == ESP_OK) {
+                err = nvs_commit(nvs);
+            }
+            nvs_close(nvs);
+        }
+
+        if (err == ESP_OK) {
+            s_flash_writes.today++;
+            s_flash_writes.total++;
+            lock_state();
+            s_history_saved = true;
+            s_history_saved_hash = hash;
+            unlock_state();
+        } else {
+            ESP_LOGE(TAG, "Failed to save streak: %s", esp_err_to_name(err));
+            lock_state();
+            s_streak_dirty = true;  // retried with the next change or flush
+            unlock_state();
+        }
+    }
+    free(snapshot);
+}
+
+// Log the day's commits and how long the NVS partition lasts at the
+// average rate, then start counting the new day
+static void log_flash_write_stats(void) {
+    s_flash_writes.days++;
+    uint32_t avg = s_flash_writes.total / s_flash_writes.days;
+
+    // A blob takes one entry per 32 bytes of data, plus its header and index
+    uint32_t entries_per_write = (sizeof(press_history_t) + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE + 2;
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
+    uint32_t pages = part ? part->size / 4096 : 0;
+    uint64_t entries_per_day = (uint64_t)(avg ? avg : 1) * entries_per_write;
+    uint64_t lifetime_days = (uint64_t)FLASH_ERASE_CYCLES * pages * NVS_ENTRIES_PER_PAGE / entries_per_day;
+
+    ESP_LOGI(TAG, "Streak flash writes: %lu yesterday, %lu total over %lu days (avg %lu/day, "
+             "%lu bytes each) - NVS wear-out in ~%llu years at this rate",
+             (unsigned long)s_flash_writes.today, (unsigned long)s_flash_writes.total,
+             (unsigned long)s_flash_writes.days, (unsigned long)avg,
+             (unsigned long)(entries_per_write * NVS_ENTRY_SIZE),
+             (unsigned long long)(lifetime_days / 365));
+    s_flash_writes.today = 0;
 }
 
 // ============== WEBHOOK ==============
@@ -583,27 +1631,254 @@ static void get_mac_address(char *mac_str, size_t len) {
              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 }
 
-static void get_current_date(char *date_str, size_t len) {
+static int32_t get_current_epoch_day(void) {
+    time_t now;
+    struct tm timeinfo;
+    time(&now);
+    localtime_r(&now, &timeinfo);
+    return days_from_civil(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
+}
+
+static uint16_t get_current_minute(void) {
     time_t now;
     struct tm timeinfo;
     time(&now);
-    now += gmt_offset_sec;
     localtime_r(&now, &timeinfo);
-    snprintf(date_str, len, "%04d-%02d-%02d",
-             timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
+    return (uint16_t)(timeinfo.tm_hour * 60 + timeinfo.tm_min);
 }
 
-static void send_webhook(bool state) {
+// Checks shared by every request to the backend
+static bool webhook_ready(void) {
+    if (!clock_valid()) {
+        ESP_LOGW(TAG, "Webhook skipped - clock not set");
+        return false;
+    }
+#if WIFI_DUTY_CYCLE
+    if (!wifi_wait_connected()) {
+        ESP_LOGW(TAG, "Webhook skipped - WiFi bring-up failed");
+        return false;
+    }
+#endif
     wifi_ap_record_t ap_info;
     if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
         ESP_LOGW(TAG, "Webhook skipped - WiFi not connected");
-        return;
+        return false;
+    }
+    return true;
+}
+
+static long long average_ms(int64_t total_ms, uint32_t count) {
+    return count ? (long long)(total_ms / count) : 0LL;
+}
+
+static char webhook_response_buffer[JOURNAL_BATCH_RESPONSE_SIZE];
+static int webhook_response_len = 0;
+
+static esp_err_t webhook_http_event_handler(esp_http_client_event_t *evt) {
+    switch (evt->event_id) {
+        case HTTP_EVENT_ON_CONNECTED:
+            // Only fires when a new TCP + TLS connection was set up
+            s_webhook_connected = true;
+            break;
+        case HTTP_EVENT_ON_HEADER:
+            apply_http_date_header(evt->header_key, evt->header_value);
+#if WIFI_DUTY_CYCLE
+            if (s_wifi_ttfb_start_us) {
+                int64_t ttfb_ms = (esp_timer_get_time() - s_wifi_ttfb_start_us) / 1000;
+                s_wifi_ttfb_start_us = 0;
+                s_wifi_bringups++;
+                s_wifi_ttfb_total_ms += ttfb_ms;
+                ESP_LOGI(TAG, "WiFi bring-up to first byte: %lld ms (avg %lld ms over %lu bring-ups)",
+                         (long long)ttfb_ms, average_ms(s_wifi_ttfb_total_ms, s_wifi_bringups),
+                         (unsigned long)s_wifi_bringups);
+            }
+#endif
+            break;
+        case HTTP_EVENT_ON_DATA:
+            if (webhook_response_len + evt->data_len < sizeof(webhook_response_buffer) - 1) {
+                memcpy(webhook_response_buffer + webhook_response_len, evt->data, evt->data_len);
+                webhook_response_len += evt->data_len;
+                webhook_response_buffer[webhook_response_len] = '\0';
+            }
+            break;
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+// Close the connection but keep the handle, and with it the TLS session
+// ticket, so the next connection can resume instead of a full handshake
+static void webhook_client_close(void) {
+    if (!s_webhook_open) return;
+    esp_http_client_close(s_webhook_client);
+    s_webhook_open = false;
+}
+
+// Drop the kept-alive connection once it has been idle for a while, before
+// the server times it out, to release the TLS buffers
+static void webhook_client_close_if_idle(void) {
+    if (s_webhook_open &&
+        esp_timer_get_time() - s_webhook_last_used_us >= (int64_t)WEBHOOK_IDLE_CLOSE_MS * 1000) {
+        ESP_LOGI(TAG, "Closing idle webhook connection");
+        webhook_client_close();
+    }
+}
+
+static void log_webhook_stats(void) {
+    uint32_t handshakes = s_webhook_stats.full_handshakes + s_webhook_stats.resumed_handshakes;
+    long long full_avg = average_ms(s_webhook_stats.full_ms, s_webhook_stats.full_handshakes);
+    long long resumed_avg = average_ms(s_webhook_stats.resumed_ms, s_webhook_stats.resumed_handshakes);
+    long long saved_ms = 0;
+    if (s_webhook_stats.full_handshakes && s_webhook_stats.resumed_handshakes) {
+        saved_ms = (full_avg - resumed_avg) * s_webhook_stats.resumed_handshakes;
+    }
+
+    ESP_LOGI(TAG, "Webhook connections: %lu full handshakes avg %lld ms, %lu resumed avg %lld ms "
+             "(%lu%% resumed, ~%lld ms saved), %lu reused avg %lld ms",
+             (unsigned long)s_webhook_stats.full_handshakes, full_avg,
+             (unsigned long)s_webhook_stats.resumed_handshakes, resumed_avg,
+             (unsigned long)(handshakes ? s_webhook_stats.resumed_handshakes * 100 / handshakes : 0),
+             saved_ms,
+             (unsigned long)s_webhook_stats.reuses,
+             average_ms(s_webhook_stats.reuse_ms, s_webhook_stats.reuses));
+}
+
+// One request on the long-lived client. Returns the status code, or -1.
+static int webhook_client_perform(const char *url, const char *payload, const char *signature_hex) {
+    if (!s_webhook_client) {
+        esp_http_client_config_t config = {
+            .url = url,
+            .timeout_ms = WEBHOOK_TIMEOUT_MS,
+            .event_handler = webhook_http_event_handler,
+            .save_client_session = true,
+#ifndef CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY
+            .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+        };
+        s_webhook_client = esp_http_client_init(&config);
+        esp_http_client_set_method(s_webhook_client, HTTP_METHOD_POST);
+        esp_http_client_set_header(s_webhook_client, "Content-Type", "application/json");
+    } else {
+        // Same host for every endpoint, so the open connection is kept
+        esp_http_client_set_url(s_webhook_client, url);
+    }
+
+    if (signature_hex) {
+        esp_http_client_set_header(s_webhook_client, "X-HMAC-Signature", signature_hex);
+    } else {
+        // The handle is reused: don't send the last request's signature
+        esp_http_client_delete_header(s_webhook_client, "X-HMAC-Signature");
+    }
+    esp_http_client_set_post_field(s_webhook_client, payload, strlen(payload));
+
+    webhook_response_len = 0;
+    webhook_response_buffer[0] = '\0';
+    s_webhook_connected = false;
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_http_client_perform(s_webhook_client);
+    int64_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+    s_webhook_last_used_us = esp_timer_get_time();
+
+    // A new connection offers the session ticket saved by the last
+    // completed handshake; whether the server accepted it shows up in the
+    // resumed vs full timings
+    const char *connection;
+    if (!s_webhook_connected) {
+        connection = "reused";
+    } else if (s_webhook_session_saved) {
+        connection = "resumed";
+    } else {
+        connection = "new";
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Webhook failed after %lld ms on %s connection: %s", (long long)elapsed_ms,
+                 connection, esp_err_to_name(err));
+        // s_webhook_open may still be false if this request opened the
+        // socket; close it anyway so the next request starts afresh
+        esp_http_client_close(s_webhook_client);
+        s_webhook_open = false;
+        return -1;
+    }
+    s_webhook_open = true;
+
+    if (!s_webhook_connected) {
+        s_webhook_stats.reuses++;
+        s_webhook_stats.reuse_ms += elapsed_ms;
+    } else if (s_webhook_session_saved) {
+        s_webhook_stats.resumed_handshakes++;
+        s_webhook_stats.resumed_ms += elapsed_ms;
+    } else {
+        s_webhook_stats.full_handshakes++;
+        s_webhook_stats.full_ms += elapsed_ms;
+        s_webhook_session_saved = true;
+    }
+
+    int status = esp_http_client_get_status_code(s_webhook_client);
+    ESP_LOGI(TAG, "Webhook response: %d in %lld ms on %s connection", status, (long long)elapsed_ms, connection);
+    log_webhook_stats();
+    return status;
+}
+
+// POST a JSON payload, signed with the hardware HMAC key when available.
+// The connection is kept alive between requests; if a reused connection
+// turns out to have been closed by the server, the request is retried once
+// on a fresh one. Returns the HTTP status code, or -1 if the request did not
+// complete. The response body is left in webhook_response_buffer.
+static int post_signed_json(const char *url, const char *payload) {
+    // Calculate and add HMAC signature if available
+    char signature_hex[65];
+    bool signed_request = calculate_hmac_signature(payload, strlen(payload), signature_hex);
+    if (signed_request) {
+        ESP_LOGI(TAG, "Request signed with hardware HMAC");
+    } else {
+        ESP_LOGW(TAG, "Request sent unsigned");
+    }
+
+    webhook_client_close_if_idle();
+    bool reused = s_webhook_open;
+
+    wifi_power_acquire();
+    int status = webhook_client_perform(url, payload, signed_request ? signature_hex : NULL);
+    if (status < 0 && reused && !s_webhook_connected) {
+        ESP_LOGW(TAG, "Kept-alive connection was dropped - reconnecting");
+        status = webhook_client_perform(url, payload, signed_request ? signature_hex : NULL);
+    }
+    wifi_power_release();
+
+    // The web app's time zone setting rides along on every response
+    if (status > 0) {
+        s_backend_answered = true;
+    }
+    char tz[TZ_MAX_LEN];
+    if (status == 200 && json_get_string(webhook_response_buffer, "timezone", tz, sizeof(tz))) {
+        update_timezone(tz);
+    }
+    return status;
+}
+
+// Only a malformed payload (400, 422) is dropped: it won't go away on a
+// retry and would hold up everything journaled behind it. Anything else,
+// including 401/403/404, can be fixed on the backend side (a rotated
+// secret, a device registered late), so those presses stay journaled.
+static webhook_result_t webhook_result_from_status(int status) {
+    if (status >= 200 && status < 300) return WEBHOOK_DELIVERED;
+    if (status == 400 || status == 422) {
+        ESP_LOGE(TAG, "Webhook rejected with status %d", status);
+        return WEBHOOK_REJECTED;
     }
+    return WEBHOOK_FAILED;
+}
+
+static webhook_result_t send_webhook(int32_t day, bool state) {
+    if (!webhook_ready()) return WEBHOOK_FAILED;
 
     char mac_str[18];
     char date_str[11];
     get_mac_address(mac_str, sizeof(mac_str));
-    get_current_date(date_str, sizeof(date_str));
+    epoch_day_to_date(day, date_str, sizeof(date_str));
 
     // Get Unix timestamp for replay protection
     time_t now;
@@ -617,84 +1892,674 @@ static void send_webhook(bool state) {
 
     ESP_LOGI(TAG, "Sending webhook: %s", payload);
 
-    esp_http_client_config_t config = {
-        .url = WEBHOOK_URL,
-        .timeout_ms = 10000,
+    return webhook_result_from_status(post_signed_json(WEBHOOK_URL, payload));
+}
+
+// Log the events the backend refused.
+// Response format: {"results":[{"seq":12,"ok":true},{"seq":13,"ok":false,"error":"..."}]}
+static void log_rejected_batch_events(void) {
+    const char *p = webhook_response_buffer;
+    while ((p = strstr(p, "\"seq\":")) != NULL) {
+        unsigned long seq = strtoul(p + 6, NULL, 10);  // Skip past "seq":
+        const char *ok = strstr(p, "\"ok\":");
+        if (!ok) break;
+        if (strncmp(ok + 5, "false", 5) == 0) {
+            ESP_LOGW(TAG, "Press seq %lu rejected by backend - discarding", seq);
+        }
+        p = ok;
+    }
+}
+
+// Send journaled presses in one signed request. The backend applies them in
+// a single Firestore batch and reports a result per event, so the whole
+// batch is either delivered or retried.
+static webhook_result_t send_press_batch(const press_journal_entry_t *entries, int count) {
+    if (!webhook_ready()) return WEBHOOK_FAILED;
+
+    static char payload[JOURNAL_BATCH_PAYLOAD_SIZE];
+    char mac_str[18];
+    get_mac_address(mac_str, sizeof(mac_str));
+
+    time_t now;
+    time(&now);
+
+    int len = snprintf(payload, sizeof(payload), "{\"mac\":\"%s\",\"timestamp\":%lld,\"events\":[",
+                       mac_str, (long long)now);
+    for (int i = 0; i < count && len < (int)sizeof(payload); i++) {
+        char date_str[11];
+        epoch_day_to_date(entries[i].day, date_str, sizeof(date_str));
+        len += snprintf(payload + len, sizeof(payload) - len,
+                        "%s{\"seq\":%lu,\"state\":%s,\"date\":\"%s\"}",
+                        i > 0 ? "," : "", (unsigned long)entries[i].seq,
+                        entries[i].state ? "true" : "false", date_str);
+    }
+    if (len < (int)sizeof(payload)) {
+        len += snprintf(payload + len, sizeof(payload) - len, "]}");
+    }
+    if (len >= (int)sizeof(payload)) {
+        ESP_LOGE(TAG, "Batch payload too large (%d bytes)", len);
+        return WEBHOOK_FAILED;
+    }
+
+    ESP_LOGI(TAG, "Sending batch of %d presses (seq %lu..%lu, %d bytes)", count,
+             (unsigned long)entries[0].seq, (unsigned long)entries[count - 1].seq, len);
+
+    webhook_result_t result = webhook_result_from_status(post_signed_json(WEBHOOK_BATCH_URL, payload));
+    if (result == WEBHOOK_DELIVERED) {
+        log_rejected_batch_events();
+    }
+    return result;
+}
+
+// ============== PRESS JOURNAL ==============
+
+static int journal_flash_read(void *ctx, uint32_t offset, void *buf, uint32_t len) {
+    return esp_partition_read(s_journal_partition, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int journal_flash_write(void *ctx, uint32_t offset, const void *buf, uint32_t len) {
+    return esp_partition_write(s_journal_partition, offset, buf, len) == ESP_OK ? 0 : -1;
+}
+
+static int journal_flash_erase(void *ctx, uint32_t sector) {
+    uint32_t sector_size = s_journal_partition->erase_size;
+    return esp_partition_erase_range(s_journal_partition, sector * sector_size, sector_size) == ESP_OK ? 0 : -1;
+}
+
+static void init_press_journal(void) {
+    s_journal_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                   JOURNAL_PARTITION_SUBTYPE,
+                                                   JOURNAL_PARTITION_LABEL);
+    if (!s_journal_partition) {
+        ESP_LOGW(TAG, "No journal partition - presses will not survive being offline");
+        return;
+    }
+
+    s_journal_flash = (press_journal_flash_t){
+        .ctx = NULL,
+        .sector_size = s_journal_partition->erase_size,
+        .sector_count = s_journal_partition->size / s_journal_partition->erase_size,
+        .read = journal_flash_read,
+        .write = journal_flash_write,
+        .erase_sector = journal_flash_erase,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
 
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
+    if (press_journal_mount(&s_journal, &s_journal_flash) != PRESS_JOURNAL_OK) {
+        ESP_LOGE(TAG, "Failed to mount press journal");
+        return;
+    }
 
-    // Calculate and add HMAC signature if available
-    char signature_hex[65];
-    if (calculate_hmac_signature(payload, strlen(payload), signature_hex)) {
-        esp_http_client_set_header(client, "X-HMAC-Signature", signature_hex);
-        ESP_LOGI(TAG, "Request signed with hardware HMAC");
+    s_journal_mutex = xSemaphoreCreateMutex();
+    s_journal_ready = true;
+    ESP_LOGI(TAG, "Press journal: %lu pending, next seq %lu, %lu torn records, max erase count %lu",
+             (unsigned long)press_journal_pending_count(&s_journal),
+             (unsigned long)s_journal.next_seq,
+             (unsigned long)s_journal.torn_records,
+             (unsigned long)s_journal.max_erase_count);
+}
+
+// Journal a press and return its sequence number in *seq (may be NULL).
+// Returns false if there is no journal or the write failed.
+static bool journal_append(int32_t day, bool state, uint32_t *seq) {
+    if (!s_journal_ready) return false;
+    press_journal_entry_t entry;
+    xSemaphoreTake(s_journal_mutex, portMAX_DELAY);
+    int err = press_journal_append(&s_journal, day, state, &entry);
+    xSemaphoreGive(s_journal_mutex);
+    if (err == PRESS_JOURNAL_OK && seq) *seq = entry.seq;
+    return err == PRESS_JOURNAL_OK;
+}
+
+// Send journaled presses oldest first, up to JOURNAL_BATCH_MAX per request.
+// Stops at the first failure so the backend always sees presses in order.
+static void replay_journal(void) {
+    if (!s_journal_ready || press_journal_pending_count(&s_journal) == 0) return;
+
+    uint32_t pending = press_journal_pending_count(&s_journal);
+    if (pending > 1) {
+        ESP_LOGI(TAG, "Replaying %lu journaled presses", (unsigned long)pending);
     }
 
-    esp_http_client_set_post_field(client, payload, strlen(payload));
+    static press_journal_entry_t entries[JOURNAL_BATCH_MAX];
+    while (true) {
+        xSemaphoreTake(s_journal_mutex, portMAX_DELAY);
+        int count = press_journal_read_pending(&s_journal, entries, JOURNAL_BATCH_MAX);
+        xSemaphoreGive(s_journal_mutex);
+        if (count == 0) return;
+
+        webhook_result_t result = send_press_batch(entries, count);
+        if (result == WEBHOOK_FAILED) {
+            ESP_LOGW(TAG, "Journal replay paused, %lu presses pending",
+                     (unsigned long)press_journal_pending_count(&s_journal));
+            return;
+        }
+        if (result == WEBHOOK_REJECTED) {
+            ESP_LOGW(TAG, "Batch seq %lu..%lu rejected by backend - discarding",
+                     (unsigned long)entries[0].seq, (unsigned long)entries[count - 1].seq);
+        }
+        xSemaphoreTake(s_journal_mutex, portMAX_DELAY);
+        press_journal_ack(&s_journal, entries[count - 1].seq);
+        xSemaphoreGive(s_journal_mutex);
+    }
+}
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Webhook response: %d", status);
+// ============== STATE SYNC ==============
+
+// Read back the last STATE_SYNC_DAYS days from the backend and merge them.
+// Journal sequence numbers decide which side is newer. The backend reports
+// the highest seq it has applied: if the journal has acked beyond it, a
+// write never landed there and the local days are uploaded again.
+// Otherwise whatever differs changed on the backend later (or was lost
+// here, e.g. by a factory reset) and its state is taken.
+static void sync_device_state(void) {
+    lock_state();
+    bool aligned = s_streak_aligned;
+    int32_t today = s_history.day;
+    uint32_t rev = s_history_rev;
+    unlock_state();
+    if (!aligned || today == STREAK_NO_DAY) return;
+
+    time_t now;
+    time(&now);
+    if (today == s_state_sync_day && now - s_state_sync_time < STATE_SYNC_MIN_INTERVAL_S) return;
+    if (!webhook_ready()) return;
+
+    char mac_str[18];
+    char date_str[11];
+    get_mac_address(mac_str, sizeof(mac_str));
+    epoch_day_to_date(today, date_str, sizeof(date_str));
+
+    char payload[160];
+    snprintf(payload, sizeof(payload),
+             "{\"mac\":\"%s\",\"timestamp\":%lld,\"date\":\"%s\",\"days\":%d}",
+             mac_str, (long long)now, date_str, STATE_SYNC_DAYS);
+
+    int status = post_signed_json(WEBHOOK_STATE_URL, payload);
+    if (status != 200) {
+        ESP_LOGW(TAG, "State sync failed (status %d)", status);
+        return;
+    }
+
+    char date[11];
+    char bits_hex[STATE_SYNC_DAYS / 4 + 1];
+    uint8_t remote[STATE_SYNC_DAYS / 8];
+    uint32_t remote_seq;
+    if (!json_get_string(webhook_response_buffer, "date", date, sizeof(date)) ||
+        strcmp(date, date_str) != 0 ||
+        !json_get_string(webhook_response_buffer, "bits", bits_hex, sizeof(bits_hex)) ||
+        !hex_to_bytes(bits_hex, remote, sizeof(remote)) ||
+        !json_get_uint(webhook_response_buffer, "seq", &remote_seq)) {
+        ESP_LOGW(TAG, "State sync: unexpected response %s", webhook_response_buffer);
+        return;
+    }
+
+    uint32_t acked_seq = s_journal_ready ? s_journal.acked_seq : 0;
+    bool remote_wins = remote_seq >= acked_seq;
+    int32_t changed[STATE_SYNC_DAYS];
+    bool local_state[STATE_SYNC_DAYS];
+
+    lock_state();
+    if (s_history_rev != rev || s_history.day != today) {
+        unlock_state();
+        ESP_LOGI(TAG, "State sync: streak changed meanwhile - will retry");
+        s_state_sync_pending = true;
+        return;
+    }
+    int count = press_history_merge(&s_history, remote, STATE_SYNC_DAYS, remote_wins,
+                                    changed, STATE_SYNC_DAYS);
+    if (remote_wins && count > 0) {
+        s_streak = press_history_streak(&s_history);
+        update_leds();
+        schedule_streak_save();
+    }
+    for (int i = 0; i < count; i++) {
+        local_state[i] = press_history_get(&s_history, changed[i], NULL);
+    }
+    unlock_state();
+
+    s_state_sync_day = today;
+    s_state_sync_time = now;
+
+    if (count == 0) {
+        ESP_LOGI(TAG, "State sync: in step with backend (seq %lu)", (unsigned long)remote_seq);
+        return;
+    }
+    ESP_LOGW(TAG, "State sync: %d of %d days differ (backend seq %lu, acked %lu) - %s", count,
+             STATE_SYNC_DAYS, (unsigned long)remote_seq, (unsigned long)acked_seq,
+             remote_wins ? "took backend state" : "uploading local state");
+    if (remote_wins) return;
+
+    for (int i = 0; i < count; i++) {
+        int32_t day = today - changed[i];
+        if (!journal_append(day, local_state[i], NULL)) {
+            send_webhook(day, local_state[i]);
+        }
+    }
+    replay_journal();
+}
+
+// ============== NETWORK WORKER ==============
+
+// Called from the input path: RAM only, it never writes flash or waits for
+// the network. The network task journals the press once its burst settles.
+// Nothing is evicted when the queue is full; the day is noted instead and
+// the network task feeds that day's state from the streak to the coalescer.
+static void queue_press_event(bool state) {
+    if (!clock_valid()) {
+        ESP_LOGW(TAG, "Press not sent - clock not set");
+        return;
+    }
+
+    xEventGroupClearBits(s_app_events, APP_NET_IDLE_BIT);
+
+    net_event_t event = {
+        .type = NET_EVENT_PRESS,
+        .state = state,
+        .day = get_current_epoch_day(),
+        .queued_us = esp_timer_get_time(),
+    };
+
+    if (xQueueSend(s_net_queue, &event, 0) != pdTRUE) {
+        s_net_dropped++;
+        s_net_overflow_day = event.day;
+        ESP_LOGW(TAG, "Network queue full - press left to the streak (%lu total)",
+                 (unsigned long)s_net_dropped);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Press queued for network (depth %u/%d)",
+             (unsigned)uxQueueMessagesWaiting(s_net_queue), NET_QUEUE_LENGTH);
+}
+
+// Ask the network task to retry the journal (WiFi up, time synced)
+static void queue_journal_replay(void) {
+    if (!s_net_queue) return;
+    net_event_t event = {
+        .type = NET_EVENT_REPLAY,
+        .queued_us = esp_timer_get_time(),
+    };
+    xQueueSend(s_net_queue, &event, 0);
+}
+
+// Ask the network task to look up a zone for a device that has none
+static void queue_timezone_lookup(void) {
+    if (!s_net_queue || s_tz_stored || s_tz_lookup_tried) return;
+    net_event_t event = {
+        .type = NET_EVENT_TZ_LOOKUP,
+        .queued_us = esp_timer_get_time(),
+    };
+    xQueueSend(s_net_queue, &event, 0);
+}
+
+// Ask the network task to read back the backend's state (connected,
+// aligned, or a new day)
+static void queue_state_sync(void) {
+    if (!s_net_queue) return;
+    net_event_t event = {
+        .type = NET_EVENT_STATE_SYNC,
+        .queued_us = esp_timer_get_time(),
+    };
+    xQueueSend(s_net_queue, &event, 0);
+}
+
+// Journal and send one settled press. Only the settled state reaches the
+// journal, so a burst costs one record and one request, and a burst that
+// cancelled itself out never gets here. Timings are measured from the
+// first toggle of the burst, so they include the settle window.
+static void send_press_op(const press_op_t *op) {
+    char date_str[11];
+    epoch_day_to_date(op->day, date_str, sizeof(date_str));
+
+    int64_t start_us = esp_timer_get_time();
+    bool delivered;
+    uint32_t seq;
+    if (journal_append(op->day, op->state, &seq)) {
+        replay_journal();
+        delivered = (s_journal.acked_seq >= seq);
     } else {
-        ESP_LOGE(TAG, "Webhook failed: %s", esp_err_to_name(err));
+        if (s_journal_ready) {
+            ESP_LOGE(TAG, "Failed to journal press - sending without a backup");
+        }
+        delivered = (send_webhook(op->day, op->state) != WEBHOOK_FAILED);
+    }
+    int64_t end_us = esp_timer_get_time();
+    leds_play(delivered ? &LED_PRESS_ACK : &LED_SYNC_FAILED);
+#ifdef DEEP_SLEEP_MODE
+    if (delivered) {
+        record_wake_to_webhook(end_us);
     }
+#endif
+
+    ESP_LOGI(TAG, "Press %s %s %s (%lu toggles): settled %lld ms, sent in %lld ms, total %lld ms "
+             "(depth %u, dropped %lu)",
+             date_str, op->state ? "ON" : "OFF",
+             delivered ? "delivered" : "pending",
+             (unsigned long)op->toggles,
+             (long long)((start_us - op->first_us) / 1000),
+             (long long)((end_us - start_us) / 1000),
+             (long long)((end_us - op->first_us) / 1000),
+             (unsigned)uxQueueMessagesWaiting(s_net_queue),
+             (unsigned long)s_net_dropped);
+}
 
-    esp_http_client_cleanup(client);
+static void coalesce_press_event(const net_event_t *event) {
+    press_op_t flushed;
+    if (press_coalescer_add(&s_coalescer, event->day, event->state, event->queued_us, &flushed)) {
+        send_press_op(&flushed);
+    }
+}
+
+static TickType_t network_task_timeout(void) {
+    TickType_t timeout = portMAX_DELAY;
+    if (s_journal_ready && press_journal_pending_count(&s_journal) > 0) {
+        timeout = pdMS_TO_TICKS(JOURNAL_RETRY_MS);
+    }
+
+    int64_t deadline = press_coalescer_deadline(&s_coalescer);
+    if (deadline != PRESS_COALESCER_NO_DEADLINE) {
+        int64_t remaining_ms = (deadline - esp_timer_get_time() + 999) / 1000;
+        TickType_t settle = remaining_ms > 0 ? pdMS_TO_TICKS(remaining_ms) + 1 : 0;
+        if (settle < timeout) timeout = settle;
+    }
+
+    if (s_webhook_open) {
+        int64_t idle_ms = (esp_timer_get_time() - s_webhook_last_used_us) / 1000;
+        int64_t remaining_ms = WEBHOOK_IDLE_CLOSE_MS - idle_ms;
+        TickType_t idle = remaining_ms > 0 ? pdMS_TO_TICKS(remaining_ms) + 1 : 0;
+        if (idle < timeout) timeout = idle;
+    }
+
+    if (s_ntp_retry_us) {
+        int64_t retry_ms = (s_ntp_retry_us - esp_timer_get_time() + 999) / 1000;
+        TickType_t retry = retry_ms > 0 ? pdMS_TO_TICKS(retry_ms) + 1 : 0;
+        if (retry < timeout) timeout = retry;
+    }
+
+#if WIFI_DUTY_CYCLE
+    int64_t resync_ms = (s_wifi_next_resync_us - esp_timer_get_time() + 999) / 1000;
+    TickType_t resync = resync_ms > 0 ? pdMS_TO_TICKS(resync_ms) + 1 : 0;
+    if (resync < timeout) timeout = resync;
+#endif
+    return timeout;
+}
+
+// Drains the event queue so TLS handshakes and HTTP round trips never run on
+// the input path. Toggles are held for PRESS_SETTLE_MS so a burst of presses
+// goes out as its final state only. While the journal holds undelivered
+// presses it is retried periodically as well as on every connectivity change.
+static void network_task(void *pvParameters) {
+    net_event_t event;
+
+    while (true) {
+        bool received = xQueueReceive(s_net_queue, &event, network_task_timeout()) == pdTRUE;
+
+        if (received && event.type == NET_EVENT_PRESS) {
+#if WIFI_DUTY_CYCLE
+            wifi_start();  // associate while the press settles
+#endif
+            coalesce_press_event(&event);
+        }
+
+        // Presses that did not fit in the queue: the streak already holds
+        // their final state, so that state settles like one more toggle
+        int32_t overflow_day = s_net_overflow_day;
+        if (overflow_day != STREAK_NO_DAY) {
+            s_net_overflow_day = STREAK_NO_DAY;
+            lock_state();
+            net_event_t missed = {
+                .type = NET_EVENT_PRESS,
+                .state = press_history_get(&s_history, s_history.day - overflow_day, NULL),
+                .day = overflow_day,
+                .queued_us = esp_timer_get_time(),
+            };
+            unlock_state();
+            coalesce_press_event(&missed);
+        }
+
+        if (received && event.type == NET_EVENT_CLOCK_PROBE) {
+            probe_clock();
+        }
+
+        if (received && event.type == NET_EVENT_TZ_LOOKUP) {
+            s_tz_lookup_pending = true;
+        }
+
+        if (received && event.type == NET_EVENT_STATE_SYNC) {
+            s_state_sync_pending = true;
+        }
+
+        if (s_ntp_retry_us && esp_timer_get_time() >= s_ntp_retry_us) {
+            retry_time_sync();
+        }
+
+#if WIFI_DUTY_CYCLE
+        if (esp_timer_get_time() >= s_wifi_next_resync_us) {
+            resync_clock();
+        }
+#endif
+
+        // A burst that ends where it started releases no op and costs
+        // neither a journal record nor a request
+        press_op_t op;
+        if (press_coalescer_poll(&s_coalescer, esp_timer_get_time(), &op)) {
+            send_press_op(&op);
+        } else if (!received || event.type == NET_EVENT_REPLAY) {
+            replay_journal();
+        }
+
+        // Only with nothing of ours in flight, so the backend has seen
+        // every local change and its answer can't undo a newer press
+        if (s_state_sync_pending && uxQueueMessagesWaiting(s_net_queue) == 0 &&
+            press_coalescer_deadline(&s_coalescer) == PRESS_COALESCER_NO_DEADLINE &&
+            (!s_journal_ready || press_journal_pending_count(&s_journal) == 0)) {
+            s_state_sync_pending = false;
+            sync_device_state();
+        }
+
+        // Any backend answer would have carried the web app's rule, so the
+        // IP lookup only runs once the backend has had its say
+        if (s_tz_lookup_pending && s_backend_answered) {
+            s_tz_lookup_pending = false;
+            lookup_legacy_timezone();
+        }
+
+        webhook_client_close_if_idle();
+
+        if (uxQueueMessagesWaiting(s_net_queue) == 0 &&
+            press_coalescer_deadline(&s_coalescer) == PRESS_COALESCER_NO_DEADLINE) {
+#if WIFI_DUTY_CYCLE
+            // Stay up until NTP has refined the clock from RTC or HTTP
+            if (ntp_synced) {
+                wifi_shut_down();
+            }
+#endif
+            xEventGroupSetBits(s_app_events, APP_NET_IDLE_BIT);
+        }
+    }
+}
+
+static void start_network_task(void) {
+    press_coalescer_init(&s_coalescer, (int64_t)PRESS_SETTLE_MS * 1000);
+    s_net_queue = xQueueCreate(NET_QUEUE_LENGTH, sizeof(net_event_t));
+    xEventGroupSetBits(s_app_events, APP_NET_IDLE_BIT);
+    xTaskCreate(network_task, "network", NET_TASK_STACK_SIZE, NULL, 5, NULL);
+#if WIFI_DUTY_CYCLE
+    // Flush anything journaled during boot, then let the radio go off
+    s_wifi_up_since_us = esp_timer_get_time();
+    schedule_wifi_resync();
+    queue_journal_replay();
+#endif
+}
+
+static void generate_claim_code(char *code, size_t len) {
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+
+    char mac_str[13];
+    snprintf(mac_str, sizeof(mac_str), "%02X%02X%02X%02X%02X%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    uint32_t hash = 0;
+    for (int i = 0; i < 12; i++) {
+        hash = hash * 31 + mac_str[i];
+    }
+
+    for (int i = 0; i < 6; i++) {
+        hash ^= (mac[i] << (i * 4));
+    }
+
+    const char *chars = "ABCDEFGHJKLMNPQRSTUVWXYZ23456789";
+    for (int i = 0; i < 10 && i < (int)len - 1; i++) {
+        code[i] = chars[hash % 32];
+        hash /= 32;
+    }
+    code[10 < len - 1 ? 10 : len - 1] = '\0';
+}
+
+// ============== WIFI CREDENTIAL PERSISTENCE ==============
+
+static void save_wifi_credentials(const char *ssid, const char *password) {
+    nvs_handle_t nvs;
+    if (nvs_open("wifi", NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_str(nvs, "ssid", ssid);
+        nvs_set_str(nvs, "password", password ? password : "");
+        nvs_erase_key(nvs, "fastcache");  // cached AP belongs to the old network
+        nvs_commit(nvs);
+        nvs_close(nvs);
+        ESP_LOGI(TAG, "WiFi credentials saved for SSID: %s", ssid);
+    }
+    memset(&s_wifi_fast_cache, 0, sizeof(s_wifi_fast_cache));
+}
+
+static void clear_wifi_credentials(void) {
+    nvs_handle_t nvs;
+    if (nvs_open("wifi", NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_erase_all(nvs);
+        nvs_commit(nvs);
+        nvs_close(nvs);
+        ESP_LOGI(TAG, "WiFi credentials cleared");
+    }
+    memset(&s_wifi_fast_cache, 0, sizeof(s_wifi_fast_cache));
+}
+
+static bool load_wifi_fast_cache(void) {
+    if (s_wifi_fast_cache.version == WIFI_FAST_CACHE_VERSION) {
+        return true;  // still in RTC memory from before deep sleep
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open("wifi", NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(s_wifi_fast_cache);
+    esp_err_t err = nvs_get_blob(nvs, "fastcache", &s_wifi_fast_cache, &len);
+    nvs_close(nvs);
+
+    if (err != ESP_OK || len != sizeof(s_wifi_fast_cache) ||
+        s_wifi_fast_cache.version != WIFI_FAST_CACHE_VERSION || s_wifi_fast_cache.channel == 0) {
+        memset(&s_wifi_fast_cache, 0, sizeof(s_wifi_fast_cache));
+        return false;
+    }
+    return true;
 }
 
-static void generate_claim_code(char *code, size_t len) {
-    uint8_t mac[6];
-    esp_read_mac(mac, ESP_MAC_WIFI_STA);
-
-    char mac_str[13];
-    snprintf(mac_str, sizeof(mac_str), "%02X%02X%02X%02X%02X%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+// Record the connection that just came up. Only written when something
+// changed, so a stable network costs no flash writes.
+static void save_wifi_fast_cache(uint32_t full_connect_ms) {
+    wifi_fast_cache_t cache = {
+        .version = WIFI_FAST_CACHE_VERSION,
+        .full_connect_ms = full_connect_ms ? full_connect_ms : s_wifi_fast_cache.full_connect_ms,
+    };
 
-    uint32_t hash = 0;
-    for (int i = 0; i < 12; i++) {
-        hash = hash * 31 + mac_str[i];
+    wifi_ap_record_t ap_info;
+    esp_netif_ip_info_t ip_info;
+    esp_netif_dns_info_t dns_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK ||
+        esp_netif_get_ip_info(s_sta_netif, &ip_info) != ESP_OK) {
+        return;
+    }
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    cache.channel = ap_info.primary;
+    cache.ip = ip_info.ip.addr;
+    cache.netmask = ip_info.netmask.addr;
+    cache.gw = ip_info.gw.addr;
+    if (esp_netif_get_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns_info) == ESP_OK) {
+        cache.dns = dns_info.ip.u_addr.ip4.addr;
     }
 
-    for (int i = 0; i < 6; i++) {
-        hash ^= (mac[i] << (i * 4));
+    if (memcmp(&cache, &s_wifi_fast_cache, sizeof(cache)) == 0) {
+        return;
     }
+    s_wifi_fast_cache = cache;
 
-    const char *chars = "ABCDEFGHJKLMNPQRSTUVWXYZ23456789";
-    for (int i = 0; i < 10 && i < (int)len - 1; i++) {
-        code[i] = chars[hash % 32];
-        hash /= 32;
+    nvs_handle_t nvs;
+    if (nvs_open("wifi", NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_blob(nvs, "fastcache", &cache, sizeof(cache));
+        nvs_commit(nvs);
+        nvs_close(nvs);
+        ESP_LOGI(TAG, "WiFi fast reconnect cache updated (channel %d)", cache.channel);
     }
-    code[10 < len - 1 ? 10 : len - 1] = '\0';
 }
 
-// ============== WIFI CREDENTIAL PERSISTENCE ==============
+static void clear_wifi_fast_cache(void) {
+    memset(&s_wifi_fast_cache, 0, sizeof(s_wifi_fast_cache));
 
-static void save_wifi_credentials(const char *ssid, const char *password) {
     nvs_handle_t nvs;
     if (nvs_open("wifi", NVS_READWRITE, &nvs) == ESP_OK) {
-        nvs_set_str(nvs, "ssid", ssid);
-        nvs_set_str(nvs, "password", password ? password : "");
+        nvs_erase_key(nvs, "fastcache");
         nvs_commit(nvs);
         nvs_close(nvs);
-        ESP_LOGI(TAG, "WiFi credentials saved for SSID: %s", ssid);
     }
 }
 
-static void clear_wifi_credentials(void) {
+// Point the STA config at the cached AP and, if enabled, set the cached
+// lease before the interface comes up
+static void apply_wifi_fast_cache(wifi_config_t *wifi_config) {
+    memcpy(wifi_config->sta.bssid, s_wifi_fast_cache.bssid, sizeof(s_wifi_fast_cache.bssid));
+    wifi_config->sta.bssid_set = true;
+    wifi_config->sta.channel = s_wifi_fast_cache.channel;
+
+#if WIFI_REUSE_IP_LEASE
+    if (s_wifi_fast_cache.ip != 0 && esp_netif_dhcpc_stop(s_sta_netif) == ESP_OK) {
+        esp_netif_ip_info_t ip_info = {
+            .ip.addr = s_wifi_fast_cache.ip,
+            .netmask.addr = s_wifi_fast_cache.netmask,
+            .gw.addr = s_wifi_fast_cache.gw,
+        };
+        esp_netif_set_ip_info(s_sta_netif, &ip_info);
+        if (s_wifi_fast_cache.dns != 0) {
+            esp_netif_dns_info_t dns_info = {
+                .ip.u_addr.ip4.addr = s_wifi_fast_cache.dns,
+                .ip.type = ESP_IPADDR_TYPE_V4,
+            };
+            esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+        }
+        s_wifi_static_ip = true;
+    }
+#endif
+
+    s_wifi_fast_connect = true;
+    ESP_LOGI(TAG, "Fast reconnect: channel %d%s", s_wifi_fast_cache.channel,
+             s_wifi_static_ip ? ", cached IP" : "");
+}
+
+static void clear_timezone(void) {
     nvs_handle_t nvs;
-    if (nvs_open("wifi", NVS_READWRITE, &nvs) == ESP_OK) {
+    if (nvs_open("time", NVS_READWRITE, &nvs) == ESP_OK) {
         nvs_erase_all(nvs);
         nvs_commit(nvs);
         nvs_close(nvs);
-        ESP_LOGI(TAG, "WiFi credentials cleared");
     }
+    set_timezone(TZ_DEFAULT);
+    s_tz_stored = false;
 }
 
 static void clear_streak_data(void) {
+    lock_state();
+    s_streak_dirty = false;  // nothing left to commit
+    s_history_saved = false;
+    unlock_state();
+
     nvs_handle_t nvs;
     if (nvs_open("streak", NVS_READWRITE, &nvs) == ESP_OK) {
         nvs_erase_all(nvs);
@@ -702,10 +2567,24 @@ static void clear_streak_data(void) {
         nvs_close(nvs);
         ESP_LOGI(TAG, "Streak data cleared");
     }
-    streak_data = 0;
-    today_state = false;
-    last_day = -1;
+    lock_state();
+    streak_init(&s_streak, 0, STREAK_NO_DAY);
+    press_history_init(&s_history, STREAK_NO_DAY);
+    s_legacy_yday = -1;
     update_leds();
+    unlock_state();
+
+    // Undelivered presses belong to the old owner too
+    if (s_journal_ready) {
+        xSemaphoreTake(s_journal_mutex, portMAX_DELAY);
+        int err = press_journal_erase(&s_journal);
+        xSemaphoreGive(s_journal_mutex);
+        if (err == PRESS_JOURNAL_OK) {
+            ESP_LOGI(TAG, "Press journal erased");
+        } else {
+            ESP_LOGE(TAG, "Failed to erase press journal");
+        }
+    }
 }
 
 // ============== CAPTIVE PORTAL HTTP HANDLERS ==============
@@ -788,7 +2667,7 @@ static esp_err_t http_scan_handler(httpd_req_t *req) {
 }
 
 static esp_err_t http_connect_handler(httpd_req_t *req) {
-    char content[256];
+    char content[384];
     int ret = httpd_req_recv(req, content, sizeof(content) - 1);
     if (ret <= 0) {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid request");
@@ -801,30 +2680,10 @@ static esp_err_t http_connect_handler(httpd_req_t *req) {
     // Simple JSON parsing
     char ssid[33] = {0};
     char password[65] = {0};
-
-    char *ssid_start = strstr(content, "\"ssid\":\"");
-    if (ssid_start) {
-        ssid_start += 8;
-        char *ssid_end = strchr(ssid_start, '"');
-        if (ssid_end) {
-            size_t len = ssid_end - ssid_start;
-            if (len < sizeof(ssid)) {
-                strncpy(ssid, ssid_start, len);
-            }
-        }
-    }
-
-    char *pass_start = strstr(content, "\"password\":\"");
-    if (pass_start) {
-        pass_start += 12;
-        char *pass_end = strchr(pass_start, '"');
-        if (pass_end) {
-            size_t len = pass_end - pass_start;
-            if (len < sizeof(password)) {
-                strncpy(password, pass_start, len);
-            }
-        }
-    }
+    char tz[TZ_MAX_LEN] = {0};
+    json_get_string(content, "ssid", ssid, sizeof(ssid));
+    json_get_string(content, "password", password, sizeof(password));
+    json_get_string(content, "tz", tz, sizeof(tz));  // browser's zone as a POSIX rule
 
     if (strlen(ssid) == 0) {
         httpd_resp_set_type(req, "application/json");
@@ -838,6 +2697,7 @@ static esp_err_t http_connect_handler(httpd_req_t *req) {
     wifi_config_t wifi_config = {
         .sta = {
             .threshold.authmode = WIFI_AUTH_OPEN,
+            .listen_interval = WIFI_IDLE_LISTEN_INTERVAL,
         },
     };
     strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
@@ -858,6 +2718,7 @@ static esp_err_t http_connect_handler(httpd_req_t *req) {
 
     // Set STA config and connect
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    leds_play(&LED_CONNECTING);
     esp_wifi_connect();
 
     // Wait for connection result
@@ -865,12 +2726,14 @@ static esp_err_t http_connect_handler(httpd_req_t *req) {
                                            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
                                            pdFALSE, pdFALSE,
                                            pdMS_TO_TICKS(15000));
+    leds_stop(&LED_CONNECTING);
 
     char response[256];
     if (bits & WIFI_CONNECTED_BIT) {
         ESP_LOGI(TAG, "Successfully connected to %s", ssid);
         save_wifi_credentials(ssid, password);
-        s_provisioning_done = true;
+        if (tz[0]) update_timezone(tz);
+        xEventGroupSetBits(s_app_events, APP_PROVISIONED_BIT);
 
         snprintf(response, sizeof(response),
                  "{\"success\":true,\"claim_code\":\"%s\"}", s_claim_code);
@@ -890,6 +2753,7 @@ static esp_err_t http_reset_handler(httpd_req_t *req) {
 
     clear_wifi_credentials();
     clear_streak_data();
+    clear_timezone();
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"success\":true}", -1);
@@ -1069,28 +2933,126 @@ static void dns_server_task(void *pvParameters) {
     vTaskDelete(NULL);
 }
 
-// ============== PROVISIONING MODE ==============
+// ============== WIFI DUTY CYCLE ==============
+#if WIFI_DUTY_CYCLE
 
-static void start_provisioning_mode(void) {
-    ESP_LOGI(TAG, "Starting WiFi provisioning (captive portal)...");
+// Start the radio without waiting for the connection. The STA config still
+// points at the cached AP when the last connect used it; otherwise the
+// cache is applied again here.
+static void wifi_start(void) {
+    if (s_wifi_running) return;
 
-    // Initialize networking if not already done
-    if (!s_netif_initialized) {
-        ESP_ERROR_CHECK(esp_netif_init());
-        ESP_ERROR_CHECK(esp_event_loop_create_default());
-        esp_netif_create_default_wifi_sta();
-        s_netif_initialized = true;
+    wifi_config_t wifi_config;
+    esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+    if (!wifi_config.sta.bssid_set && load_wifi_fast_cache()) {
+        apply_wifi_fast_cache(&wifi_config);
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
     }
 
-    // Create AP interface
-    esp_netif_create_default_wifi_ap();
+    s_retry_num = 0;
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+    s_wifi_connect_start_us = esp_timer_get_time();
+    s_wifi_up_since_us = s_wifi_connect_start_us;
+    s_wifi_ttfb_start_us = s_wifi_connect_start_us;
+    s_wifi_connecting = true;
+    s_wifi_running = true;
+    esp_wifi_start();
+}
 
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+// Block until the connection started by wifi_start() is up. Gives up (and
+// turns the radio off again) WIFI_BRINGUP_TIMEOUT_MS after the start.
+static bool wifi_wait_connected(void) {
+    wifi_start();
+    if (!s_wifi_connecting) return true;
+    s_wifi_connecting = false;
 
-    s_wifi_event_group = xEventGroupCreate();
+    int64_t elapsed_ms = (esp_timer_get_time() - s_wifi_connect_start_us) / 1000;
+    int64_t remaining_ms = WIFI_BRINGUP_TIMEOUT_MS - elapsed_ms;
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
+                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                                           pdFALSE, pdFALSE,
+                                           remaining_ms > 0 ? pdMS_TO_TICKS(remaining_ms) : 0);
+    bool fast = s_wifi_fast_connect;
+    s_wifi_fast_connect = false;
+
+    if (!(bits & WIFI_CONNECTED_BIT)) {
+        ESP_LOGW(TAG, "WiFi bring-up failed");
+        wifi_shut_down();
+        return false;
+    }
+
+    uint32_t connect_ms = (uint32_t)((esp_timer_get_time() - s_wifi_connect_start_us) / 1000);
+    ESP_LOGI(TAG, "WiFi up in %lu ms via %s", (unsigned long)connect_ms,
+             fast ? "fast reconnect" : "full scan");
+    save_wifi_fast_cache(fast ? 0 : connect_ms);
+    return true;
+}
+
+static void wifi_shut_down(void) {
+    if (!s_wifi_running) return;
+
+    // Keeps the client handle and with it the TLS session ticket
+    webhook_client_close();
+    s_wifi_running = false;
+    s_wifi_connecting = false;
+    s_wifi_ttfb_start_us = 0;
+    esp_wifi_stop();
+    xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+
+    int64_t now = esp_timer_get_time();
+    s_wifi_on_total_us += now - s_wifi_up_since_us;
+    ESP_LOGI(TAG, "WiFi off after %lld ms (radio on %.2f%% of uptime)",
+             (long long)((now - s_wifi_up_since_us) / 1000), 100.0 * s_wifi_on_total_us / now);
+}
+
+static void schedule_wifi_resync(void) {
+    int64_t wait_s = WIFI_RESYNC_INTERVAL_S;
+    if (clock_valid()) {
+        // A few seconds past midnight so the rollover has happened
+        time_t now = time(NULL);
+        int64_t until_midnight_s = next_local_midnight(now) - now + 5;
+        if (until_midnight_s < wait_s) wait_s = until_midnight_s;
+    }
+    s_wifi_next_resync_us = esp_timer_get_time() + wait_s * 1000000;
+}
+
+// Bring the radio up to let SNTP correct the clock; the journal replay
+// that follows in network_task() uses the same bring-up
+static void resync_clock(void) {
+    schedule_wifi_resync();
+    if (!wifi_wait_connected()) return;
+
+    xEventGroupClearBits(s_app_events, APP_NTP_SYNCED_BIT);
+    esp_sntp_restart();
+    EventBits_t bits = xEventGroupWaitBits(s_app_events, APP_NTP_SYNCED_BIT, pdTRUE, pdFALSE,
+                                           pdMS_TO_TICKS(WIFI_NTP_WAIT_MS));
+    if (!(bits & APP_NTP_SYNCED_BIT)) {
+        ESP_LOGW(TAG, "Clock resync timed out");
+    }
+    schedule_wifi_resync();
+}
+
+#endif // WIFI_DUTY_CYCLE
+
+// ============== NETWORK STACK ==============
+
+// Initialize networking and the STA interface once per boot. Provisioning
+// can follow a failed saved-network connect, which has done this already.
+static void init_netif(void) {
+    if (s_netif_initialized) return;
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    s_sta_netif = esp_netif_create_default_wifi_sta();
+    s_netif_initialized = true;
+    init_time_sync();
+}
 
-    // Register event handlers
+// The default event loop outlives esp_wifi_deinit(), and so do handlers
+// registered on it: register them once, or every event is handled twice
+// after a failed saved-network connect falls back to provisioning
+static void register_wifi_handlers(void) {
+    static bool registered = false;
+    if (registered) return;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &wifi_event_handler,
@@ -1099,6 +3061,24 @@ static void start_provisioning_mode(void) {
                                                         IP_EVENT_STA_GOT_IP,
                                                         &wifi_event_handler,
                                                         NULL, NULL));
+    registered = true;
+}
+
+// ============== PROVISIONING MODE ==============
+
+static void start_provisioning_mode(void) {
+    ESP_LOGI(TAG, "Starting WiFi provisioning (captive portal)...");
+
+    init_netif();
+
+    // Create AP interface
+    esp_netif_create_default_wifi_ap();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+
+    s_wifi_event_group = xEventGroupCreate();
+    register_wifi_handlers();
 
     // Configure AP
     wifi_config_t ap_config = {
@@ -1114,6 +3094,7 @@ static void start_provisioning_mode(void) {
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
+    s_wifi_running = true;
     ESP_ERROR_CHECK(esp_wifi_start());
 
     ESP_LOGI(TAG, "AP started: %s", AP_SSID);
@@ -1125,10 +3106,8 @@ static void start_provisioning_mode(void) {
     start_webserver();
 
     // Wait for provisioning to complete
-    while (!s_provisioning_done) {
-        animate_leds();
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
+    leds_play(&LED_PROVISIONING);
+    xEventGroupWaitBits(s_app_events, APP_PROVISIONED_BIT, pdTRUE, pdFALSE, portMAX_DELAY);
 
     ESP_LOGI(TAG, "Provisioning complete!");
 
@@ -1142,17 +3121,17 @@ static void start_provisioning_mode(void) {
     // Switch to STA only mode
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
 
-    // Turn off animation LEDs
-    for (int i = 0; i < 7; i++) {
-        gpio_set_level(LED_PINS[i], 0);
-    }
+    leds_stop(&LED_PROVISIONING);
 }
 
-static bool connect_with_saved_credentials(void) {
+// Start connecting to the saved network without waiting for the result, so
+// other boot stages can run while the STA associates. Returns false if no
+// credentials are saved.
+static bool start_saved_wifi(void) {
     nvs_handle_t nvs;
-    char ssid[33] = {0};
+    char *ssid = s_wifi_ssid;
     char password[65] = {0};
-    size_t ssid_len = sizeof(ssid);
+    size_t ssid_len = sizeof(s_wifi_ssid);
     size_t pass_len = sizeof(password);
 
     if (nvs_open("wifi", NVS_READONLY, &nvs) != ESP_OK) {
@@ -1160,11 +3139,23 @@ static bool connect_with_saved_credentials(void) {
         return false;
     }
 
-    esp_err_t err = nvs_get_str(nvs, "ssid", ssid, &ssid_len);
-    if (err != ESP_OK || strlen(ssid) == 0) {
-        nvs_close(nvs);
-        ESP_LOGI(TAG, "No saved WiFi credentials found");
-        return false;
+#ifdef DEEP_SLEEP_MODE
+    // Wakes take the SSID from RTC memory, next to the fast reconnect
+    // cache. The password is only ever read from NVS.
+    if (s_rtc_state.magic == RTC_STATE_MAGIC && s_rtc_state.ssid[0] != '\0') {
+        strcpy(ssid, s_rtc_state.ssid);
+    } else
+#endif
+    {
+        esp_err_t err = nvs_get_str(nvs, "ssid", ssid, &ssid_len);
+        if (err != ESP_OK || strlen(ssid) == 0) {
+            nvs_close(nvs);
+            ESP_LOGI(TAG, "No saved WiFi credentials found");
+            return false;
+        }
+#ifdef DEEP_SLEEP_MODE
+        strcpy(s_rtc_state.ssid, ssid);
+#endif
     }
 
     nvs_get_str(nvs, "password", password, &pass_len);
@@ -1172,66 +3163,65 @@ static bool connect_with_saved_credentials(void) {
 
     ESP_LOGI(TAG, "Attempting to connect to saved network: %s", ssid);
 
-    // Initialize networking
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
-    s_netif_initialized = true;
+    init_netif();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     s_wifi_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &wifi_event_handler,
-                                                        NULL, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &wifi_event_handler,
-                                                        NULL, NULL));
+    register_wifi_handlers();
 
     wifi_config_t wifi_config = {
         .sta = {
             .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .listen_interval = WIFI_IDLE_LISTEN_INTERVAL,
         },
     };
     strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
     strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+    if (load_wifi_fast_cache()) {
+        apply_wifi_fast_cache(&wifi_config);
+    }
 
+    s_wifi_connect_start_us = esp_timer_get_time();
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    s_wifi_running = true;
     ESP_ERROR_CHECK(esp_wifi_start());
+    return true;
+}
 
-    // Animate LEDs while connecting
-    uint32_t start_time = millis();
-    const uint32_t timeout = 15000;
-
-    while ((millis() - start_time) < timeout) {
-        animate_leds();
-
-        EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                               WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                               pdFALSE, pdFALSE,
-                                               pdMS_TO_TICKS(100));
-        if (bits & (WIFI_CONNECTED_BIT | WIFI_FAIL_BIT)) {
-            break;
-        }
-    }
+// Wait for the connection begun by start_saved_wifi(). The LEDs keep
+// showing the streak meanwhile, since the buttons are already live, with
+// today's LED breathing.
+static bool wait_for_saved_wifi(void) {
+    const char *ssid = s_wifi_ssid;
+    leds_play(&LED_CONNECTING);
+    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
+                        pdFALSE, pdFALSE, pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS));
+    leds_stop(&LED_CONNECTING);
 
-    // Turn off animation LEDs
-    for (int i = 0; i < 7; i++) {
-        gpio_set_level(LED_PINS[i], 0);
-    }
+    bool fast = s_wifi_fast_connect;
+    s_wifi_fast_connect = false;
 
     EventBits_t bits = xEventGroupGetBits(s_wifi_event_group);
     if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to %s", ssid);
+        int64_t now = esp_timer_get_time();
+        uint32_t total_ms = (uint32_t)((now - s_wifi_connect_start_us) / 1000);
+        ESP_LOGI(TAG, "Connected to %s in %lu ms via %s (associated %lld ms, IP %lld ms later)",
+                 ssid, (unsigned long)total_ms, fast ? "fast reconnect" : "full scan",
+                 (long long)((s_wifi_associated_us - s_wifi_connect_start_us) / 1000),
+                 (long long)((now - s_wifi_associated_us) / 1000));
+        if (fast && s_wifi_fast_cache.full_connect_ms) {
+            ESP_LOGI(TAG, "Last full-scan connect took %lu ms",
+                     (unsigned long)s_wifi_fast_cache.full_connect_ms);
+        }
+        save_wifi_fast_cache(fast ? 0 : total_ms);
         return true;
     }
 
     ESP_LOGW(TAG, "Failed to connect with saved credentials");
+    s_wifi_running = false;
     esp_wifi_stop();
     esp_wifi_deinit();
     // Note: esp_netif is kept initialized for provisioning mode
@@ -1241,10 +3231,326 @@ static bool connect_with_saved_credentials(void) {
     return false;
 }
 
+static bool connect_with_saved_credentials(void) {
+    return start_saved_wifi() && wait_for_saved_wifi();
+}
+
+// ============== POWER MANAGEMENT ==============
+
+static void init_power_management(void) {
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = PM_MIN_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Power management not enabled: %s", esp_err_to_name(err));
+        return;
+    }
+
+    // Button presses wake the chip; see setup_button()
+    esp_sleep_enable_gpio_wakeup();
+    ESP_LOGI(TAG, "Power management: %d-%d MHz, automatic light sleep", PM_MIN_FREQ_MHZ, PM_MAX_FREQ_MHZ);
+}
+
+// Drop the connected STA into modem sleep; called once WiFi is up
+static void start_wifi_power_save(void) {
+    xSemaphoreTake(s_wifi_power_mutex, portMAX_DELAY);
+    s_wifi_power_save = true;
+    s_wifi_power_start_us = esp_timer_get_time();
+    if (s_wifi_power_refs > 0) {
+        s_wifi_full_power_since_us = s_wifi_power_start_us;
+    } else {
+        esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+    }
+    xSemaphoreGive(s_wifi_power_mutex);
+    ESP_LOGI(TAG, "WiFi power save: max modem, listen interval %d", WIFI_IDLE_LISTEN_INTERVAL);
+}
+
+// Hold the radio at full power for a network exchange. Nests; every call
+// must be paired with wifi_power_release().
+static void wifi_power_acquire(void) {
+    xSemaphoreTake(s_wifi_power_mutex, portMAX_DELAY);
+    if (s_wifi_power_refs++ == 0 && s_wifi_power_save) {
+        esp_wifi_set_ps(WIFI_PS_NONE);
+        s_wifi_full_power_since_us = esp_timer_get_time();
+        s_wifi_power_exchanges++;
+    }
+    xSemaphoreGive(s_wifi_power_mutex);
+}
+
+static void wifi_power_release(void) {
+    xSemaphoreTake(s_wifi_power_mutex, portMAX_DELAY);
+    if (--s_wifi_power_refs == 0 && s_wifi_power_save) {
+        esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+        s_wifi_full_power_us += esp_timer_get_time() - s_wifi_full_power_since_us;
+    }
+    xSemaphoreGive(s_wifi_power_mutex);
+}
+
+// Estimated radio duty cycle since power save started: full-power spans
+// count as 100%, idle time as one beacon wake per listen interval
+static void log_wifi_power_stats(void) {
+    xSemaphoreTake(s_wifi_power_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - s_wifi_power_start_us;
+    int64_t full_us = s_wifi_full_power_us;
+    if (s_wifi_power_refs > 0) {
+        full_us += now - s_wifi_full_power_since_us;
+    }
+    uint32_t exchanges = s_wifi_power_exchanges;
+    bool enabled = s_wifi_power_save;
+    xSemaphoreGive(s_wifi_power_mutex);
+
+    if (!enabled || elapsed_us <= 0) return;
+
+    double idle_duty = (double)WIFI_BEACON_WAKE_US / (WIFI_IDLE_LISTEN_INTERVAL * WIFI_BEACON_INTERVAL_US);
+    double default_duty = (double)WIFI_BEACON_WAKE_US / WIFI_BEACON_INTERVAL_US;
+    double duty = (full_us + (elapsed_us - full_us) * idle_duty) / elapsed_us;
+    ESP_LOGI(TAG, "WiFi radio: full power %.3f%% of %lld s (%lu exchanges), "
+             "est. duty cycle %.2f%% (default power save %.2f%%, always on 100%%)",
+             100.0 * full_us / elapsed_us, (long long)(elapsed_us / 1000000),
+             (unsigned long)exchanges, 100.0 * duty, 100.0 * default_duty);
+}
+
+// Time spent in each power mode since boot, including the share asleep
+static void log_power_stats(void) {
+#ifdef CONFIG_PM_PROFILING
+    ESP_LOGI(TAG, "Power management statistics:");
+    esp_pm_dump_locks(stdout);
+#endif
+    log_wifi_power_stats();
+}
+
+// ============== MAIN LOOP ==============
+
+// Block until the next power statistics dump; the midnight timer and clock
+// changes wake the loop earlier
+static TickType_t main_loop_timeout(int64_t next_stats_us) {
+    int64_t wait_ms = (next_stats_us - esp_timer_get_time() + 999) / 1000;
+    return pdMS_TO_TICKS(wait_ms > 0 ? wait_ms : 0) + 1;
+}
+
+static void main_loop(void) {
+    int64_t next_stats_us = esp_timer_get_time() + (int64_t)POWER_STATS_INTERVAL_S * 1000000;
+
+    while (true) {
+        EventBits_t bits = xEventGroupWaitBits(s_app_events,
+                                               APP_TIME_CHANGED_BIT | APP_MIDNIGHT_BIT | APP_STREAK_SAVE_BIT,
+                                               pdTRUE, pdFALSE, main_loop_timeout(next_stats_us));
+        if (bits & APP_TIME_CHANGED_BIT) {
+            ESP_LOGI(TAG, "Clock changed - re-arming the midnight timer");
+        }
+
+        if (bits & (APP_TIME_CHANGED_BIT | APP_MIDNIGHT_BIT)) {
+            reconcile_clock();
+        }
+
+        if (bits & APP_STREAK_SAVE_BIT) {
+            flush_streak();
+        }
+
+        if (esp_timer_get_time() >= next_stats_us) {
+            next_stats_us += (int64_t)POWER_STATS_INTERVAL_S * 1000000;
+            log_power_stats();
+            update_led_brightness();
+        }
+    }
+}
+
+// ============== DEEP SLEEP ==============
+#ifdef DEEP_SLEEP_MODE
+
+// Restore the state kept across deep sleep. Returns false on a cold boot.
+static bool restore_rtc_state(void) {
+    s_wake_cause = esp_sleep_get_wakeup_cause();
+    if (s_wake_cause == ESP_SLEEP_WAKEUP_UNDEFINED || s_rtc_state.magic != RTC_STATE_MAGIC) {
+        memset(&s_rtc_state, 0, sizeof(s_rtc_state));
+        memset(&s_wifi_fast_cache, 0, sizeof(s_wifi_fast_cache));
+        return false;
+    }
+
+    s_history = s_rtc_state.history;
+    s_streak = press_history_streak(&s_history);
+    s_history_saved = s_rtc_state.history_saved;
+    s_history_saved_hash = s_rtc_state.history_saved_hash;
+    s_state_sync_day = s_rtc_state.state_sync_day;
+    s_state_sync_time = s_rtc_state.state_sync_time;
+    s_flash_writes = s_rtc_state.flash_writes;
+    set_timezone(timezone_rule_valid(s_rtc_state.tz) ? s_rtc_state.tz : TZ_DEFAULT);
+    s_tz_stored = s_rtc_state.tz_stored;
+    s_tz_lookup_tried = s_rtc_state.tz_lookup_tried;
+    s_clock_source = s_rtc_state.time_valid ? CLOCK_SOURCE_RTC : CLOCK_SOURCE_NONE;
+    s_streak_aligned = clock_valid();
+
+    // ext1 left the button under RTC IO control; hand it back to the GPIO matrix
+    rtc_gpio_deinit(BUTTON_PIN);
+
+    ESP_LOGI(TAG, "Woke from deep sleep (%s)",
+             s_wake_cause == ESP_SLEEP_WAKEUP_EXT1 ? "button" :
+             s_wake_cause == ESP_SLEEP_WAKEUP_TIMER ? "timer" : "other");
+    return true;
+}
+
+static void save_rtc_state(void) {
+    lock_state();
+    s_rtc_state.history = s_history;
+    s_rtc_state.history_saved = s_history_saved;
+    s_rtc_state.history_saved_hash = s_history_saved_hash;
+    s_rtc_state.state_sync_day = s_state_sync_day;
+    s_rtc_state.state_sync_time = s_state_sync_time;
+    unlock_state();
+    s_rtc_state.flash_writes = s_flash_writes;
+    strlcpy(s_rtc_state.tz, s_tz, sizeof(s_rtc_state.tz));
+    s_rtc_state.tz_stored = s_tz_stored;
+    s_rtc_state.tz_lookup_tried = s_tz_lookup_tried;
+    s_rtc_state.time_valid = clock_valid();
+    s_rtc_state.magic = RTC_STATE_MAGIC;
+}
+
+static void record_wake_to_webhook(int64_t delivered_us) {
+    static bool recorded = false;
+    if (recorded || s_wake_cause != ESP_SLEEP_WAKEUP_EXT1) return;
+    recorded = true;
+
+    // esp_timer starts with the application, so ROM and bootloader time
+    // (tens of ms) is not included
+    int64_t latency_ms = delivered_us / 1000;
+    s_rtc_state.button_wakes++;
+    s_rtc_state.wake_to_webhook_ms += latency_ms;
+    ESP_LOGI(TAG, "Wake to webhook: %lld ms (avg %lld ms over %lu button wakes)",
+             (long long)latency_ms,
+             (long long)(s_rtc_state.wake_to_webhook_ms / s_rtc_state.button_wakes),
+             (unsigned long)s_rtc_state.button_wakes);
+}
+
+static bool resync_due(void) {
+    return !s_rtc_state.time_valid || time(NULL) - s_rtc_state.last_sync >= DEEP_SLEEP_RESYNC_S;
+}
+
+static void enter_deep_sleep(void) {
+    flush_streak();
+    save_rtc_state();
+
+    // The RTC timer is the midnight alarm here; it also survives the sleep
+    time_t now = time(NULL);
+    int64_t sleep_s = clock_valid() ? next_local_midnight(now) - now + 1 : DEEP_SLEEP_RETRY_S;
+    if (s_journal_ready && press_journal_pending_count(&s_journal) > 0 && sleep_s > DEEP_SLEEP_RETRY_S) {
+        sleep_s = DEEP_SLEEP_RETRY_S;
+    }
+
+    // Digital pull-ups are off in deep sleep; keep the button pulled up
+    rtc_gpio_pullup_en(BUTTON_PIN);
+    rtc_gpio_pulldown_dis(BUTTON_PIN);
+    esp_sleep_enable_ext1_wakeup_io(1ULL << BUTTON_PIN, ESP_EXT1_WAKEUP_ANY_LOW);
+    esp_sleep_enable_timer_wakeup(sleep_s * 1000000LL);
+
+    ESP_LOGI(TAG, "Entering deep sleep for %lld s after %lld ms awake",
+             (long long)sleep_s, (long long)(esp_timer_get_time() / 1000));
+    esp_deep_sleep_start();
+}
+
+// Stay awake while the buttons are in use and until the network task has
+// delivered (or given up on) everything, then sleep
+static void deep_sleep_loop(void) {
+    reconcile_clock();
+
+    int64_t net_deadline_us = esp_timer_get_time() + (int64_t)DEEP_SLEEP_NET_TIMEOUT_MS * 1000;
+    while (true) {
+        EventBits_t bits = xEventGroupClearBits(s_app_events,
+                                                APP_TIME_CHANGED_BIT | APP_STREAK_SAVE_BIT | APP_BUTTON_BIT);
+        if (bits & APP_TIME_CHANGED_BIT) {
+            reconcile_clock();
+        }
+        if (bits & APP_STREAK_SAVE_BIT) {
+            flush_streak();
+        }
+
+        int64_t now = esp_timer_get_time();
+        bool pressed = button_debounce_is_pressed(&s_button_db) || button_debounce_is_pressed(&s_boot_db);
+        int64_t input_deadline_us = s_last_input_us + (int64_t)DEEP_SLEEP_AWAKE_MS * 1000;
+        bool buttons_idle = now >= input_deadline_us && !pressed;
+        // A resync keeps the device up until SNTP answers (or the timeout)
+        bool synced = !s_wake_resync || (bits & APP_NTP_SYNCED_BIT);
+        bool net_idle = ((bits & APP_NET_IDLE_BIT) && synced) || now >= net_deadline_us;
+        if (buttons_idle && net_idle) break;
+
+        if (!buttons_idle) {
+            net_deadline_us = now + (int64_t)DEEP_SLEEP_NET_TIMEOUT_MS * 1000;
+        }
+
+        // Block until whichever of these is still missing happens: the
+        // network task going idle, SNTP, the buttons going quiet
+        EventBits_t wait = APP_TIME_CHANGED_BIT | APP_STREAK_SAVE_BIT | APP_BUTTON_BIT;
+        int64_t wake_us = -1;
+        if (!net_idle) {
+            wait |= (bits & APP_NET_IDLE_BIT) ? APP_NTP_SYNCED_BIT : APP_NET_IDLE_BIT;
+            wake_us = net_deadline_us;
+        }
+        if (!pressed && now < input_deadline_us && (wake_us < 0 || input_deadline_us < wake_us)) {
+            wake_us = input_deadline_us;
+        }
+        TickType_t timeout = portMAX_DELAY;
+        if (wake_us >= 0) {
+            int64_t remaining_ms = (wake_us - now + 999) / 1000;
+            timeout = remaining_ms > 0 ? pdMS_TO_TICKS(remaining_ms) + 1 : 0;
+        }
+        xEventGroupWaitBits(s_app_events, wait, pdFALSE, pdFALSE, timeout);
+    }
+
+    enter_deep_sleep();
+}
+
+// Handle a wake from deep sleep and go back to sleep; never returns
+static void run_deep_sleep_wake(void) {
+    lock_state();
+    update_leds();
+    unlock_state();
+    start_network_task();
+    start_button_task();
+
+    // A midnight wake only needs the network for undelivered presses or a
+    // stale clock
+    bool pending = s_journal_ready && press_journal_pending_count(&s_journal) > 0;
+    if (s_wake_cause == ESP_SLEEP_WAKEUP_EXT1 || pending || resync_due()) {
+        if (connect_with_saved_credentials()) {
+            if (resync_due()) {
+                s_wake_resync = true;
+                start_time_sync();
+            }
+        } else {
+            ESP_LOGW(TAG, "WiFi unavailable - presses stay journaled until the next wake");
+        }
+        lock_state();
+        update_leds();
+        unlock_state();
+    }
+
+    deep_sleep_loop();
+}
+
+#endif // DEEP_SLEEP_MODE
+
 // ============== MAIN ==============
 
 void app_main(void) {
     ESP_LOGI(TAG, "\n\n=== Streak Tracker ===");
+    boot_mark("app_main");
+
+    s_state_mutex = xSemaphoreCreateMutex();
+    s_wifi_power_mutex = xSemaphoreCreateMutex();
+    s_app_events = xEventGroupCreate();
+
+    // Initialize hardware
+    setup_leds();
+#if LED_BENCHMARK
+    led_driver_benchmark();
+#endif
+    setup_button();
+    setup_boot_button();
+    init_power_management();
+    boot_mark("gpio");
 
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
@@ -1253,67 +3559,72 @@ void app_main(void) {
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    esp_register_shutdown_handler(flush_streak);  // commit a pending streak save on esp_restart()
+    boot_mark("nvs");
 
-    // Generate claim code
+    // Identity is read before the deep-sleep wake branch, which never
+    // returns: a wake sends presses too and they have to be signed
     generate_claim_code(s_claim_code, sizeof(s_claim_code));
+    s_hmac_available = check_hmac_key_available();
+    boot_mark("identity");
+
+#ifdef DEEP_SLEEP_MODE
+    if (restore_rtc_state()) {
+        init_press_journal();
+        run_deep_sleep_wake();
+    }
+#endif
+
+    // Load saved streak data
+    load_timezone();
+    load_streak();
+
+    // After a soft reset the RTC still knows the time; align the streak to
+    // it now so presses made before WiFi is up are dated right away
+    if (restore_clock_checkpoint()) {
+        reconcile_clock();
+    }
+    update_leds();
+    boot_mark("streak leds");
+
+    // Mount the offline press journal before anything can be queued
+    init_press_journal();
+
+    // Buttons and LEDs are live from here on; presses made before the
+    // clock is synced are held and sent by align_streak_to_clock()
+    start_network_task();
+    start_button_task();
+    boot_mark("input live");
+
+    // Associate in the background while the device identification is logged
+    bool wifi_started = start_saved_wifi();
 
-    // Log device identification
     char mac_str[18];
     get_mac_address(mac_str, sizeof(mac_str));
 
-    // Check if hardware HMAC key is available
-    s_hmac_available = check_hmac_key_available();
-
     ESP_LOGI(TAG, "----------------------------------------");
     ESP_LOGI(TAG, "MAC Address:  %s", mac_str);
     ESP_LOGI(TAG, "Claim Code:   %s", s_claim_code);
     ESP_LOGI(TAG, "HMAC Signing: %s", s_hmac_available ? "ENABLED" : "DISABLED");
     ESP_LOGI(TAG, "----------------------------------------");
 
-    // Initialize hardware
-    setup_leds();
-    setup_button();
-    setup_boot_button();
-
-    // Load saved streak data
-    load_streak();
-    update_leds();
-
-    // Try to connect with saved WiFi credentials
-    if (connect_with_saved_credentials()) {
+    if (wifi_started && wait_for_saved_wifi()) {
         ESP_LOGI(TAG, "Connected with saved credentials!");
     } else {
         ESP_LOGI(TAG, "No saved credentials or connection failed, starting provisioning...");
         start_provisioning_mode();
     }
-
-    // Restore streak LEDs after WiFi setup
-    update_leds();
-
-    // Sync time
-    sync_ntp();
-
-    // Main loop
-    uint32_t last_time_log = 0;
-    while (true) {
-        handle_button();
-        check_boot_button();
-        check_midnight_rollover();
-
-        // Log local time every 10 seconds
-        uint32_t now = millis();
-        if (now - last_time_log >= 10000) {
-            last_time_log = now;
-            time_t t = time(NULL);
-            t += gmt_offset_sec;  // Apply timezone offset
-            struct tm timeinfo;
-            localtime_r(&t, &timeinfo);
-            ESP_LOGI(TAG, "Local time: %04d-%02d-%02d %02d:%02d:%02d (UTC%+.1f)",
-                     timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                     timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec,
-                     gmt_offset_sec / 3600.0);
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
+    start_wifi_power_save();
+    boot_mark("wifi");
+
+    // Runs in the background; reconcile_clock() picks up the result
+    start_time_sync();
+
+#ifdef DEEP_SLEEP_MODE
+    deep_sleep_loop();
+#else
+    // Everything else is driven by interrupts, queues and timers; the main
+    // task only wakes for midnight, clock changes and power statistics
+    main_loop();
+#endif
 }
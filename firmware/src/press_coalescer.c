@@ -0,0 +1,52 @@
+#include "press_coalescer.h"
+
+void press_coalescer_init(press_coalescer_t *c, int64_t settle_us) {
+    c->settle_us = settle_us;
+    c->pending = false;
+    c->baseline = false;
+    c->deadline_us = PRESS_COALESCER_NO_DEADLINE;
+}
+
+// Hand out the pending operation; false if the burst cancelled itself out
+static bool release(press_coalescer_t *c, press_op_t *op) {
+    c->pending = false;
+    c->deadline_us = PRESS_COALESCER_NO_DEADLINE;
+    if (c->op.state == c->baseline) {
+        return false;
+    }
+    *op = c->op;
+    return true;
+}
+
+bool press_coalescer_add(press_coalescer_t *c, int32_t day, bool state, int64_t now_us,
+                         press_op_t *flushed) {
+    bool released = false;
+    if (c->pending && c->op.day != day) {
+        released = release(c, flushed);
+    }
+
+    if (!c->pending) {
+        // Every press toggles the bit, so the day was in the opposite state
+        c->pending = true;
+        c->baseline = !state;
+        c->op.day = day;
+        c->op.toggles = 0;
+        c->op.first_us = now_us;
+    }
+
+    c->op.state = state;
+    c->op.toggles++;
+    c->deadline_us = now_us + c->settle_us;
+    return released;
+}
+
+bool press_coalescer_poll(press_coalescer_t *c, int64_t now_us, press_op_t *op) {
+    if (!c->pending || now_us < c->deadline_us) {
+        return false;
+    }
+    return release(c, op);
+}
+
+int64_t press_coalescer_deadline(const press_coalescer_t *c) {
+    return c->deadline_us;
+}
@@ -0,0 +1,53 @@
+#ifndef PRESS_COALESCER_H
+#define PRESS_COALESCER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Collapses rapid toggles of a day's bit into a single network operation.
+//
+// Each toggle restarts a settle window; once the window passes without
+// another toggle, the final state is released for sending. If the burst
+// ends on the state the day had before it started (an even number of
+// toggles), nothing needs to be sent at all. A toggle for a different day
+// releases the pending one immediately so days are never merged.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+#define PRESS_COALESCER_NO_DEADLINE (-1)
+
+// Default settle window, overridable with -DPRESS_SETTLE_MS=...
+#ifndef PRESS_SETTLE_MS
+#define PRESS_SETTLE_MS 1500
+#endif
+
+typedef struct {
+    int32_t day;
+    bool state;
+    uint32_t toggles;       // toggles merged into this operation
+    int64_t first_us;       // time of the first toggle in the burst
+} press_op_t;
+
+typedef struct {
+    int64_t settle_us;
+    bool pending;
+    bool baseline;          // state of the day before the burst started
+    press_op_t op;
+    int64_t deadline_us;
+} press_coalescer_t;
+
+void press_coalescer_init(press_coalescer_t *c, int64_t settle_us);
+
+// Feed one toggle that set the day's bit to state. Returns true and fills
+// *flushed if a pending operation for another day had to be released.
+bool press_coalescer_add(press_coalescer_t *c, int32_t day, bool state, int64_t now_us,
+                         press_op_t *flushed);
+
+// Release the pending operation if its settle window has passed. Returns
+// true and fills *op only if the final state differs from the baseline.
+bool press_coalescer_poll(press_coalescer_t *c, int64_t now_us, press_op_t *op);
+
+// Time at which press_coalescer_poll() next needs to run, or NO_DEADLINE.
+int64_t press_coalescer_deadline(const press_coalescer_t *c);
+
+#endif // PRESS_COALESCER_H
@@ -0,0 +1,168 @@
+#include "press_history.h"
+
+#include <string.h>
+
+#define PRESS_HISTORY_BYTES (PRESS_HISTORY_DAYS / 8)
+
+// Version 1 offsets, see press_history.h
+#define V1_DAYS    2
+#define V1_DAY     4
+#define V1_PRESSED 8
+#define V1_MINUTE  (V1_PRESSED + PRESS_HISTORY_BYTES)
+#define V1_SIZE    (V1_MINUTE + PRESS_HISTORY_DAYS * 2)
+
+void press_history_init(press_history_t *h, int32_t day) {
+    memset(h, 0, sizeof(*h));
+    h->version = PRESS_HISTORY_VERSION;
+    h->size = sizeof(*h);
+    h->days = PRESS_HISTORY_DAYS;
+    h->day = day;
+    for (int i = 0; i < PRESS_HISTORY_DAYS; i++) {
+        h->minute[i] = PRESS_HISTORY_NO_MINUTE;
+    }
+}
+
+void press_history_from_streak(press_history_t *h, const streak_t *s) {
+    press_history_init(h, s->day);
+    for (int i = 0; i < STREAK_DAYS; i++) {
+        bool pressed = (s->bits >> (STREAK_DAYS - 1 - i)) & 1;
+        press_history_set(h, i, pressed, PRESS_HISTORY_NO_MINUTE);
+    }
+}
+
+streak_t press_history_streak(const press_history_t *h) {
+    streak_t s;
+    uint8_t bits = 0;
+    for (int i = 0; i < STREAK_DAYS; i++) {
+        if (press_history_get(h, i, NULL)) {
+            bits |= (uint8_t)(1u << (STREAK_DAYS - 1 - i));
+        }
+    }
+    streak_init(&s, bits, h->day);
+    return s;
+}
+
+int32_t press_history_advance(press_history_t *h, int32_t today) {
+    if (h->day == STREAK_NO_DAY) {
+        h->day = today;
+        return 0;
+    }
+    if (today <= h->day) {
+        return 0;
+    }
+
+    int32_t days = today - h->day;
+    h->day = today;
+    if (days >= PRESS_HISTORY_DAYS) {
+        press_history_init(h, today);
+        return days;
+    }
+
+    // Move every day `days` further into the past, a byte at a time
+    int bytes = days / 8;
+    int bits = days % 8;
+    for (int i = PRESS_HISTORY_BYTES - 1; i >= 0; i--) {
+        int src = i - bytes;
+        uint8_t v = src >= 0 ? (uint8_t)(h->pressed[src] << bits) : 0;
+        if (bits && src >= 1) {
+            v |= (uint8_t)(h->pressed[src - 1] >> (8 - bits));
+        }
+        h->pressed[i] = v;
+    }
+
+    memmove(&h->minute[days], &h->minute[0], (PRESS_HISTORY_DAYS - days) * sizeof(h->minute[0]));
+    for (int i = 0; i < days; i++) {
+        h->minute[i] = PRESS_HISTORY_NO_MINUTE;
+    }
+    return days;
+}
+
+bool press_history_get(const press_history_t *h, int32_t days_ago, uint16_t *minute) {
+    if (days_ago < 0 || days_ago >= PRESS_HISTORY_DAYS) {
+        if (minute) *minute = PRESS_HISTORY_NO_MINUTE;
+        return false;
+    }
+    if (minute) *minute = h->minute[days_ago];
+    return (h->pressed[days_ago / 8] >> (days_ago % 8)) & 1;
+}
+
+bool press_history_set(press_history_t *h, int32_t days_ago, bool pressed, uint16_t minute) {
+    if (days_ago < 0 || days_ago >= PRESS_HISTORY_DAYS) {
+        return false;
+    }
+    uint8_t mask = (uint8_t)(1u << (days_ago % 8));
+    if (pressed) {
+        h->pressed[days_ago / 8] |= mask;
+        h->minute[days_ago] = minute;
+    } else {
+        h->pressed[days_ago / 8] &= (uint8_t)~mask;
+        h->minute[days_ago] = PRESS_HISTORY_NO_MINUTE;
+    }
+    return true;
+}
+
+int press_history_count(const press_history_t *h, int32_t days) {
+    if (days > PRESS_HISTORY_DAYS) days = PRESS_HISTORY_DAYS;
+    int count = 0;
+    for (int32_t i = 0; i < days; i++) {
+        count += press_history_get(h, i, NULL);
+    }
+    return count;
+}
+
+int press_history_merge(press_history_t *h, const uint8_t *remote, int32_t days,
+                        bool remote_wins, int32_t *changed, int max_changed) {
+    if (days > PRESS_HISTORY_DAYS) days = PRESS_HISTORY_DAYS;
+    int count = 0;
+    for (int32_t i = 0; i < days; i++) {
+        bool theirs = (remote[i / 8] >> (i % 8)) & 1;
+        if (press_history_get(h, i, NULL) == theirs) continue;
+
+        if (count < max_changed) changed[count] = i;
+        count++;
+        if (remote_wins) {
+            press_history_set(h, i, theirs, PRESS_HISTORY_NO_MINUTE);
+        }
+    }
+    return count;
+}
+
+bool press_history_decode(press_history_t *h, const void *blob, size_t len) {
+    if (len < 1) {
+        return false;
+    }
+    const uint8_t *raw = blob;
+    switch (raw[0]) {
+    case 1: {
+        if (len != V1_SIZE) return false;
+        uint16_t days;
+        memcpy(&days, raw + V1_DAYS, sizeof(days));
+        if (days != PRESS_HISTORY_DAYS) return false;
+        int32_t day;
+        memcpy(&day, raw + V1_DAY, sizeof(day));
+        press_history_init(h, day);
+        memcpy(h->pressed, raw + V1_PRESSED, sizeof(h->pressed));
+        memcpy(h->minute, raw + V1_MINUTE, sizeof(h->minute));
+        return true;
+    }
+    case 2: {
+        if (len != sizeof(*h)) return false;
+        press_history_t v2;
+        memcpy(&v2, blob, sizeof(v2));
+        if (v2.size != sizeof(v2) || v2.days != PRESS_HISTORY_DAYS) return false;
+        *h = v2;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+uint32_t press_history_hash(const press_history_t *h) {
+    const uint8_t *raw = (const uint8_t *)h;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(*h); i++) {
+        hash = (hash ^ raw[i]) * 16777619u;
+    }
+    return hash;
+}
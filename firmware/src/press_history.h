@@ -0,0 +1,84 @@
+#ifndef PRESS_HISTORY_H
+#define PRESS_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "streak_engine.h"
+
+// A little over a year of daily press state, kept on the device so it can
+// answer history queries and re-upload missed days without the backend.
+//
+// Days are addressed by how long ago they were: 0 is the newest day (`day`,
+// a local epoch day, or STREAK_NO_DAY until the clock is first known), 1 the
+// day before, and so on. Each day has a pressed bit and the local minute of
+// the press that set it (0-1439), 2 bytes per day.
+//
+// The struct is also the NVS blob layout, version PRESS_HISTORY_VERSION:
+//
+//   0      layout version
+//   1      reserved, 0x00
+//   2..3   blob size in bytes, header included
+//   4..5   PRESS_HISTORY_DAYS
+//   6..7   reserved, 0x0000
+//   8..11  newest epoch day
+//   12..59 pressed bitmap, bit (n % 8) of byte n / 8 is n days ago
+//   60..   press minute per day, PRESS_HISTORY_NO_MINUTE when unknown
+//
+// Version 1 had no size field (days at 2..3, day at 4..7, bitmap at 8..55,
+// minutes from 56) and is still read.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+#define PRESS_HISTORY_VERSION    2
+#define PRESS_HISTORY_DAYS       384  // multiple of 8, more than a leap year
+#define PRESS_HISTORY_NO_MINUTE  0xFFFF
+
+typedef struct {
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t size;
+    uint16_t days;
+    uint16_t reserved2;
+    int32_t day;
+    uint8_t pressed[PRESS_HISTORY_DAYS / 8];
+    uint16_t minute[PRESS_HISTORY_DAYS];
+} press_history_t;
+
+void press_history_init(press_history_t *h, int32_t day);
+
+// Seed the last seven days from a streak, for state saved before the
+// history existed. The press minutes are unknown.
+void press_history_from_streak(press_history_t *h, const streak_t *s);
+
+// The last seven days in streak form (bit 6 is the newest day)
+streak_t press_history_streak(const press_history_t *h);
+
+// Same rules as streak_advance(): one shift for any gap, days beyond
+// PRESS_HISTORY_DAYS are dropped, an unknown day is adopted and a clock
+// that went backwards changes nothing. Returns the days shifted.
+int32_t press_history_advance(press_history_t *h, int32_t today);
+
+// Out-of-range days read as unpressed and can't be set
+bool press_history_get(const press_history_t *h, int32_t days_ago, uint16_t *minute);
+bool press_history_set(press_history_t *h, int32_t days_ago, bool pressed, uint16_t minute);
+
+// Pressed days among the newest `days`
+int press_history_count(const press_history_t *h, int32_t days);
+
+// Compare the newest `days` with `remote`, a bitmap in the same order as
+// `pressed` for the same newest day. The days that differ are written to
+// `changed` (as days ago, up to max_changed) and, when `remote_wins`, take
+// the remote state with an unknown minute. Returns the number that differ.
+int press_history_merge(press_history_t *h, const uint8_t *remote, int32_t days,
+                        bool remote_wins, int32_t *changed, int max_changed);
+
+// Load a stored blob, converting older versions. Returns false for an
+// unknown version or a size that doesn't match it, leaving h untouched.
+bool press_history_decode(press_history_t *h, const void *blob, size_t len);
+
+// FNV-1a of the blob, to tell whether it differs from the stored copy
+uint32_t press_history_hash(const press_history_t *h);
+
+#endif // PRESS_HISTORY_H
@@ -0,0 +1,445 @@
+#include "press_journal.h"
+
+#include <string.h>
+
+#define JOURNAL_MAGIC      0x4E524A50u  // "PJRN"
+#define MOUNT_CHUNK_SLOTS  16           // records per flash read while mounting (one 256-byte page)
+#define ACK_OFFSET         9
+#define ACK_PENDING        0xFF
+#define ACK_DELIVERED      0x00
+
+typedef enum {
+    SLOT_EMPTY,
+    SLOT_VALID,
+    SLOT_TORN,
+} slot_kind_t;
+
+typedef struct {
+    uint32_t sector;
+    uint32_t slot;
+} journal_pos_t;
+
+// Page of records buffered by the mount scan
+typedef struct {
+    uint8_t buf[MOUNT_CHUNK_SLOTS * PRESS_JOURNAL_RECORD_SIZE];
+    journal_pos_t first;  // slot in buf[0]
+    uint32_t count;       // records in buf, 0 = nothing buffered
+    bool failed;
+} mount_chunk_t;
+
+// ============== ENCODING ==============
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t record_crc(const uint8_t *rec) {
+    uint32_t crc = crc32_update(0, rec, 9);
+    return crc32_update(crc, rec + 10, 2);
+}
+
+static void encode_record(uint8_t *rec, uint32_t seq, int32_t day, bool state) {
+    put_u32(rec, seq);
+    put_u32(rec + 4, (uint32_t)day);
+    rec[8] = state ? 1 : 0;
+    rec[ACK_OFFSET] = ACK_PENDING;
+    rec[10] = 0;
+    rec[11] = 0;
+    put_u32(rec + 12, record_crc(rec));
+}
+
+static slot_kind_t decode_record(const uint8_t *rec, press_journal_entry_t *entry, bool *acked) {
+    bool erased = true;
+    for (int i = 0; i < PRESS_JOURNAL_RECORD_SIZE; i++) {
+        if (rec[i] != 0xFF) {
+            erased = false;
+            break;
+        }
+    }
+    if (erased) return SLOT_EMPTY;
+
+    if (get_u32(rec + 12) != record_crc(rec) || rec[8] > 1 || rec[10] != 0 || rec[11] != 0) {
+        return SLOT_TORN;
+    }
+
+    entry->seq = get_u32(rec);
+    entry->day = (int32_t)get_u32(rec + 4);
+    entry->state = rec[8] != 0;
+    // Anything but a fully programmed ack byte is treated as pending
+    *acked = (rec[ACK_OFFSET] == ACK_DELIVERED);
+    return SLOT_VALID;
+}
+
+// ============== FLASH LAYOUT ==============
+
+static uint32_t slot_addr(const press_journal_t *j, journal_pos_t pos) {
+    return pos.sector * j->flash->sector_size + PRESS_JOURNAL_HEADER_SIZE +
+           pos.slot * PRESS_JOURNAL_RECORD_SIZE;
+}
+
+static journal_pos_t addr_pos(const press_journal_t *j, uint32_t addr) {
+    journal_pos_t pos;
+    pos.sector = addr / j->flash->sector_size;
+    pos.slot = (addr % j->flash->sector_size - PRESS_JOURNAL_HEADER_SIZE) / PRESS_JOURNAL_RECORD_SIZE;
+    return pos;
+}
+
+static journal_pos_t next_pos(const press_journal_t *j, journal_pos_t pos) {
+    pos.slot++;
+    if (pos.slot >= j->slots_per_sector) {
+        pos.slot = 0;
+        pos.sector = (pos.sector + 1) % j->flash->sector_count;
+    }
+    return pos;
+}
+
+// Position the next append will use, normalised past a full head sector
+static journal_pos_t head_pos(const press_journal_t *j) {
+    journal_pos_t pos = {j->head_sector, j->head_slot};
+    if (pos.slot >= j->slots_per_sector) {
+        pos.slot = 0;
+        pos.sector = (pos.sector + 1) % j->flash->sector_count;
+    }
+    return pos;
+}
+
+static bool pos_equal(journal_pos_t a, journal_pos_t b) {
+    return a.sector == b.sector && a.slot == b.slot;
+}
+
+static slot_kind_t read_slot(const press_journal_t *j, journal_pos_t pos,
+                             press_journal_entry_t *entry, bool *acked) {
+    uint8_t rec[PRESS_JOURNAL_RECORD_SIZE];
+    uint32_t addr = slot_addr(j, pos);
+    if (j->flash->read(j->flash->ctx, addr, rec, sizeof(rec)) != 0) {
+        return SLOT_TORN;
+    }
+    entry->addr = addr;
+    return decode_record(rec, entry, acked);
+}
+
+// read_slot() for the mount scan, which walks every slot of a sector in
+// order: the records are read a page at a time instead of one by one
+static slot_kind_t read_slot_chunked(const press_journal_t *j, mount_chunk_t *chunk, journal_pos_t pos,
+                                     press_journal_entry_t *entry, bool *acked) {
+    if (chunk->count == 0 || pos.sector != chunk->first.sector || pos.slot < chunk->first.slot ||
+        pos.slot >= chunk->first.slot + chunk->count) {
+        uint32_t count = j->slots_per_sector - pos.slot;
+        if (count > MOUNT_CHUNK_SLOTS) count = MOUNT_CHUNK_SLOTS;
+        chunk->first = pos;
+        chunk->count = count;
+        chunk->failed = j->flash->read(j->flash->ctx, slot_addr(j, pos), chunk->buf,
+                                       count * PRESS_JOURNAL_RECORD_SIZE) != 0;
+    }
+    if (chunk->failed) {
+        return SLOT_TORN;
+    }
+    entry->addr = slot_addr(j, pos);
+    return decode_record(chunk->buf + (pos.slot - chunk->first.slot) * PRESS_JOURNAL_RECORD_SIZE,
+                         entry, acked);
+}
+
+static bool read_header(const press_journal_t *j, uint32_t sector, uint32_t *erase_count, uint32_t *first_seq) {
+    uint8_t hdr[PRESS_JOURNAL_HEADER_SIZE];
+    if (j->flash->read(j->flash->ctx, sector * j->flash->sector_size, hdr, sizeof(hdr)) != 0) {
+        return false;
+    }
+    if (get_u32(hdr) != JOURNAL_MAGIC || get_u32(hdr + 12) != crc32_update(0, hdr, 12)) {
+        return false;
+    }
+    *erase_count = get_u32(hdr + 4);
+    *first_seq = get_u32(hdr + 8);
+    return true;
+}
+
+static int format_sector(press_journal_t *j, uint32_t sector) {
+    uint32_t erase_count, first_seq;
+    if (!read_header(j, sector, &erase_count, &first_seq)) {
+        // Header lost (never formatted or torn erase) - best estimate
+        erase_count = j->max_erase_count;
+    }
+    erase_count++;
+
+    if (j->flash->erase_sector(j->flash->ctx, sector) != 0) {
+        return PRESS_JOURNAL_ERR_IO;
+    }
+
+    uint8_t hdr[PRESS_JOURNAL_HEADER_SIZE];
+    put_u32(hdr, JOURNAL_MAGIC);
+    put_u32(hdr + 4, erase_count);
+    put_u32(hdr + 8, j->next_seq);
+    put_u32(hdr + 12, crc32_update(0, hdr, 12));
+    if (j->flash->write(j->flash->ctx, sector * j->flash->sector_size, hdr, sizeof(hdr)) != 0) {
+        return PRESS_JOURNAL_ERR_IO;
+    }
+
+    if (erase_count > j->max_erase_count) {
+        j->max_erase_count = erase_count;
+    }
+    j->head_erase_count = erase_count;
+    return PRESS_JOURNAL_OK;
+}
+
+// Move the tail forward to the oldest pending record, or to the head
+static void settle_tail(press_journal_t *j) {
+    journal_pos_t head = head_pos(j);
+    journal_pos_t pos = addr_pos(j, j->tail_addr);
+    press_journal_entry_t entry;
+    bool acked;
+
+    while (j->pending > 0 && !pos_equal(pos, head)) {
+        if (read_slot(j, pos, &entry, &acked) == SLOT_VALID && !acked && entry.seq > j->acked_seq) {
+            break;
+        }
+        pos = next_pos(j, pos);
+    }
+    if (j->pending == 0) {
+        pos = head;
+    }
+    j->tail_addr = slot_addr(j, pos);
+}
+
+// ============== PUBLIC API ==============
+
+int press_journal_mount(press_journal_t *j, const press_journal_flash_t *flash) {
+    if (!flash || flash->sector_count < 2 ||
+        flash->sector_size < PRESS_JOURNAL_HEADER_SIZE + PRESS_JOURNAL_RECORD_SIZE) {
+        return PRESS_JOURNAL_ERR_ARG;
+    }
+
+    memset(j, 0, sizeof(*j));
+    j->flash = flash;
+    j->slots_per_sector = (flash->sector_size - PRESS_JOURNAL_HEADER_SIZE) / PRESS_JOURNAL_RECORD_SIZE;
+
+    uint32_t max_seq = 0;
+    uint32_t head_sector = 0;
+    int head_last_used = -1;
+    bool head_formatted = false;
+    uint32_t head_erase_count = 0;
+    int sector0_last_used = -1;
+    bool sector0_formatted = false;
+    uint32_t sector0_erase_count = 0;
+    mount_chunk_t chunk = {.count = 0};
+
+    // Pass 1: newest record (the head), delivery watermark and wear
+    for (uint32_t sector = 0; sector < flash->sector_count; sector++) {
+        uint32_t erase_count, first_seq;
+        if (!read_header(j, sector, &erase_count, &first_seq)) {
+            continue;
+        }
+        if (erase_count > j->max_erase_count) {
+            j->max_erase_count = erase_count;
+        }
+
+        int last_used = -1;
+        bool holds_max = false;
+        for (uint32_t slot = 0; slot < j->slots_per_sector; slot++) {
+            journal_pos_t pos = {sector, slot};
+            press_journal_entry_t entry;
+            bool acked;
+            slot_kind_t kind = read_slot_chunked(j, &chunk, pos, &entry, &acked);
+            if (kind == SLOT_EMPTY) continue;
+
+            last_used = (int)slot;
+            if (kind == SLOT_TORN) {
+                j->torn_records++;
+                continue;
+            }
+            if (entry.seq < first_seq) continue;  // survived an interrupted erase
+            if (entry.seq > max_seq) {
+                max_seq = entry.seq;
+                holds_max = true;
+            }
+            if (acked && entry.seq > j->acked_seq) {
+                j->acked_seq = entry.seq;
+            }
+        }
+
+        if (holds_max) {
+            head_sector = sector;
+            head_last_used = last_used;
+            head_formatted = true;
+            head_erase_count = erase_count;
+        }
+        if (sector == 0) {
+            sector0_last_used = last_used;
+            sector0_formatted = true;
+            sector0_erase_count = erase_count;
+        }
+    }
+
+    if (max_seq == 0) {
+        // Empty journal: start at sector 0
+        head_sector = 0;
+        head_last_used = sector0_last_used;
+        head_formatted = sector0_formatted;
+        head_erase_count = sector0_erase_count;
+    }
+
+    j->head_sector = head_sector;
+    j->head_slot = (uint32_t)(head_last_used + 1);
+    j->head_formatted = head_formatted;
+    j->head_erase_count = head_erase_count;
+    j->next_seq = max_seq + 1;
+
+    // Pass 2: oldest undelivered record (the tail)
+    uint32_t tail_seq = 0;
+    j->tail_addr = slot_addr(j, head_pos(j));
+    for (uint32_t sector = 0; sector < flash->sector_count; sector++) {
+        uint32_t erase_count, first_seq;
+        if (!read_header(j, sector, &erase_count, &first_seq)) {
+            continue;
+        }
+        for (uint32_t slot = 0; slot < j->slots_per_sector; slot++) {
+            journal_pos_t pos = {sector, slot};
+            press_journal_entry_t entry;
+            bool acked;
+            if (read_slot_chunked(j, &chunk, pos, &entry, &acked) != SLOT_VALID) continue;
+            if (entry.seq < first_seq || acked || entry.seq <= j->acked_seq) continue;
+
+            j->pending++;
+            if (tail_seq == 0 || entry.seq < tail_seq) {
+                tail_seq = entry.seq;
+                j->tail_addr = entry.addr;
+            }
+        }
+    }
+
+    return PRESS_JOURNAL_OK;
+}
+
+int press_journal_append(press_journal_t *j, int32_t day, bool state, press_journal_entry_t *entry) {
+    if (j->head_slot >= j->slots_per_sector || !j->head_formatted) {
+        uint32_t sector = j->head_sector;
+        if (j->head_slot >= j->slots_per_sector) {
+            sector = (j->head_sector + 1) % j->flash->sector_count;
+        }
+
+        // Ring is full: the oldest undelivered presses live in the sector
+        // about to be erased
+        journal_pos_t tail = addr_pos(j, j->tail_addr);
+        if (j->pending > 0 && tail.sector == sector && j->head_sector != sector) {
+            for (journal_pos_t pos = tail; pos.sector == sector; pos = next_pos(j, pos)) {
+                press_journal_entry_t lost;
+                bool acked;
+                if (read_slot(j, pos, &lost, &acked) == SLOT_VALID && !acked && lost.seq > j->acked_seq) {
+                    j->pending--;
+                    j->dropped++;
+                    j->acked_seq = lost.seq;
+                }
+                if (pos.slot + 1 >= j->slots_per_sector) break;
+            }
+        }
+
+        int err = format_sector(j, sector);
+        j->head_sector = sector;
+        j->head_slot = 0;
+        if (err != PRESS_JOURNAL_OK) {
+            j->head_formatted = false;
+            return err;
+        }
+        j->head_formatted = true;
+
+        if (j->pending > 0 && tail.sector == sector) {
+            j->tail_addr = slot_addr(j, (journal_pos_t){(sector + 1) % j->flash->sector_count, 0});
+            settle_tail(j);
+        } else if (j->pending == 0) {
+            j->tail_addr = slot_addr(j, head_pos(j));
+        }
+    }
+
+    uint8_t rec[PRESS_JOURNAL_RECORD_SIZE];
+    uint32_t seq = j->next_seq;
+    journal_pos_t pos = {j->head_sector, j->head_slot};
+    uint32_t addr = slot_addr(j, pos);
+    encode_record(rec, seq, day, state);
+
+    // The slot is consumed even if the write fails part way
+    j->head_slot++;
+    j->next_seq++;
+    if (j->flash->write(j->flash->ctx, addr, rec, sizeof(rec)) != 0) {
+        return PRESS_JOURNAL_ERR_IO;
+    }
+
+    if (j->pending == 0) {
+        j->tail_addr = addr;
+    }
+    j->pending++;
+
+    if (entry) {
+        entry->seq = seq;
+        entry->day = day;
+        entry->state = state;
+        entry->addr = addr;
+    }
+    return PRESS_JOURNAL_OK;
+}
+
+int press_journal_read_pending(press_journal_t *j, press_journal_entry_t *entries, int max) {
+    journal_pos_t head = head_pos(j);
+    journal_pos_t pos = addr_pos(j, j->tail_addr);
+    int count = 0;
+
+    while (count < max && count < (int)j->pending && !pos_equal(pos, head)) {
+        bool acked;
+        if (read_slot(j, pos, &entries[count], &acked) == SLOT_VALID &&
+            !acked && entries[count].seq > j->acked_seq) {
+            count++;
+        }
+        pos = next_pos(j, pos);
+    }
+    return count;
+}
+
+int press_journal_ack(press_journal_t *j, uint32_t seq) {
+    journal_pos_t head = head_pos(j);
+    journal_pos_t pos = addr_pos(j, j->tail_addr);
+    const uint8_t delivered = ACK_DELIVERED;
+
+    while (j->pending > 0 && !pos_equal(pos, head)) {
+        press_journal_entry_t entry;
+        bool acked;
+        if (read_slot(j, pos, &entry, &acked) == SLOT_VALID && !acked && entry.seq > j->acked_seq) {
+            if (entry.seq > seq) break;
+            if (j->flash->write(j->flash->ctx, entry.addr + ACK_OFFSET, &delivered, 1) != 0) {
+                j->tail_addr = entry.addr;
+                return PRESS_JOURNAL_ERR_IO;
+            }
+            j->acked_seq = entry.seq;
+            j->pending--;
+        }
+        pos = next_pos(j, pos);
+    }
+
+    j->tail_addr = slot_addr(j, pos);
+    settle_tail(j);
+    return PRESS_JOURNAL_OK;
+}
+
+int press_journal_erase(press_journal_t *j) {
+    const press_journal_flash_t *flash = j->flash;
+    for (uint32_t sector = 0; sector < flash->sector_count; sector++) {
+        if (flash->erase_sector(flash->ctx, sector) != 0) {
+            return PRESS_JOURNAL_ERR_IO;
+        }
+    }
+    return press_journal_mount(j, flash);
+}
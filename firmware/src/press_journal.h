@@ -0,0 +1,88 @@
+#ifndef PRESS_JOURNAL_H
+#define PRESS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Append-only ring journal of presses that still have to reach the backend.
+//
+// The journal occupies a dedicated flash partition split into erase sectors
+// that are written strictly in sequence, so every sector is erased once per
+// trip around the ring. Each sector starts with a header; records are
+// 16 bytes:
+//
+//   0..3   sequence number (little endian, monotonic, starts at 1)
+//   4..7   local epoch day
+//   8      state (0 = off, 1 = on)
+//   9      ack byte: 0xFF pending, 0x00 delivered (outside the CRC)
+//   10..11 reserved, 0x00
+//   12..15 CRC-32 of bytes 0..8 and 10..11
+//
+// A write interrupted by power loss leaves a record whose CRC does not match;
+// it is skipped on mount and never reused. Acks only clear bits, so they are
+// programmed in place without an erase. Delivery is idempotent on the
+// backend, so a torn ack simply causes the record to be sent again.
+//
+// Flash access goes through press_journal_flash_t so the same code runs on
+// esp_partition and on the simulated flash used by the host tests.
+
+#define PRESS_JOURNAL_RECORD_SIZE 16
+#define PRESS_JOURNAL_HEADER_SIZE 16
+
+#define PRESS_JOURNAL_OK         0
+#define PRESS_JOURNAL_ERR_IO    -1
+#define PRESS_JOURNAL_ERR_ARG   -2
+
+typedef struct {
+    void *ctx;
+    uint32_t sector_size;
+    uint32_t sector_count;
+    int (*read)(void *ctx, uint32_t offset, void *buf, uint32_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *buf, uint32_t len);
+    int (*erase_sector)(void *ctx, uint32_t sector);
+} press_journal_flash_t;
+
+typedef struct {
+    uint32_t seq;
+    int32_t day;
+    bool state;
+    uint32_t addr;  // flash offset of the record
+} press_journal_entry_t;
+
+typedef struct {
+    const press_journal_flash_t *flash;
+    uint32_t slots_per_sector;
+    uint32_t head_sector;       // sector receiving appends
+    uint32_t head_slot;         // next free slot in head_sector
+    bool head_formatted;        // head_sector has a valid header
+    uint32_t head_erase_count;  // erase count of head_sector
+    uint32_t tail_addr;         // oldest pending record (== head when empty)
+    uint32_t next_seq;
+    uint32_t acked_seq;         // every record up to this seq is delivered
+    uint32_t pending;
+
+    // Statistics
+    uint32_t torn_records;      // unreadable records found at mount
+    uint32_t dropped;           // pending records overwritten when full
+    uint32_t max_erase_count;
+} press_journal_t;
+
+int press_journal_mount(press_journal_t *j, const press_journal_flash_t *flash);
+
+// Append a press; the assigned sequence number is returned in *entry
+int press_journal_append(press_journal_t *j, int32_t day, bool state, press_journal_entry_t *entry);
+
+// Copy up to max pending records, oldest first. Returns the number copied.
+int press_journal_read_pending(press_journal_t *j, press_journal_entry_t *entries, int max);
+
+// Mark every pending record up to and including seq as delivered
+int press_journal_ack(press_journal_t *j, uint32_t seq);
+
+// Erase the whole journal and remount it empty (factory reset)
+int press_journal_erase(press_journal_t *j);
+
+static inline uint32_t press_journal_pending_count(const press_journal_t *j) {
+    return j->pending;
+}
+
+#endif // PRESS_JOURNAL_H
@@ -0,0 +1,43 @@
+#include "streak_engine.h"
+
+#include "clock_util.h"
+
+void streak_init(streak_t *s, uint8_t bits, int32_t day) {
+    s->bits = bits & STREAK_MASK;
+    s->day = day;
+}
+
+int32_t streak_advance(streak_t *s, int32_t today) {
+    if (s->day == STREAK_NO_DAY) {
+        s->day = today;
+        return 0;
+    }
+    if (today <= s->day) {
+        return 0;
+    }
+
+    int32_t days = today - s->day;
+    s->bits = days >= STREAK_DAYS ? 0 : (uint8_t)(s->bits >> days);
+    s->day = today;
+    return days;
+}
+
+bool streak_today(const streak_t *s) {
+    return (s->bits & STREAK_TODAY_BIT) != 0;
+}
+
+bool streak_toggle_today(streak_t *s) {
+    s->bits ^= STREAK_TODAY_BIT;
+    return streak_today(s);
+}
+
+int32_t streak_day_from_yday(int yday, int32_t today) {
+    int year, month, day;
+    civil_from_days(today, &year, &month, &day);
+
+    int32_t candidate = days_from_civil(year, 1, 1) + yday;
+    if (candidate > today) {
+        candidate = days_from_civil(year - 1, 1, 1) + yday;
+    }
+    return candidate;
+}
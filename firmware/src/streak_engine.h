@@ -0,0 +1,44 @@
+#ifndef STREAK_ENGINE_H
+#define STREAK_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The last seven days of presses, keyed by local epoch day (days since
+// 1970-01-01, see clock_util.h). Bit 6 is `day`, bit 0 is six days before.
+//
+// Catching up after any absence is a single shift, so a reconciliation
+// costs one state change and one write no matter how long the device was
+// off, across year boundaries and leap days alike.
+//
+// No ESP-IDF dependencies - this file is also built for the host tests.
+
+#define STREAK_DAYS       7
+#define STREAK_MASK       ((uint8_t)((1u << STREAK_DAYS) - 1))
+#define STREAK_TODAY_BIT  ((uint8_t)(1u << (STREAK_DAYS - 1)))
+#define STREAK_NO_DAY     INT32_MIN  // day not known yet (never synced)
+
+typedef struct {
+    uint8_t bits;
+    int32_t day;    // epoch day of bit 6, or STREAK_NO_DAY
+} streak_t;
+
+void streak_init(streak_t *s, uint8_t bits, int32_t day);
+
+// Move the streak forward to `today`, dropping days that fall out of the
+// window; returns the number of days shifted. An unknown day is adopted
+// without shifting. A clock that went backwards leaves the state alone and
+// returns 0, so the same days are never shifted twice.
+int32_t streak_advance(streak_t *s, int32_t today);
+
+bool streak_today(const streak_t *s);
+
+// Flip today's bit and return its new state
+bool streak_toggle_today(streak_t *s);
+
+// Most recent epoch day on or before `today` whose day of the year
+// (0-based, as struct tm's tm_yday) is `yday`. Converts the day stored by
+// firmware that kept only tm_yday.
+int32_t streak_day_from_yday(int yday, int32_t today);
+
+#endif // STREAK_ENGINE_H
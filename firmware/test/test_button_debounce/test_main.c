@@ -0,0 +1,152 @@
+#include <unity.h>
+
+#include "button_debounce.h"
+
+// Edge traces in the shape the ISR records for a bouncy tactile switch
+// (level, microseconds since boot). The replay below drives the state
+// machine the same way button_task does: poll at the edge timestamp, feed the
+// edge, and poll again whenever the debounce deadline passes.
+
+#define SETTLE_US 50000
+
+typedef struct {
+    int level;
+    int64_t time_us;
+} edge_t;
+
+typedef struct {
+    int presses;
+    int releases;
+    int64_t first_press_us;
+} replay_result_t;
+
+static void count_event(replay_result_t *r, button_event_t ev, int64_t now_us) {
+    if (ev == BUTTON_EVENT_PRESS) {
+        if (r->presses == 0) r->first_press_us = now_us;
+        r->presses++;
+    } else if (ev == BUTTON_EVENT_RELEASE) {
+        r->releases++;
+    }
+}
+
+static replay_result_t replay(const edge_t *trace, int count, int64_t end_us) {
+    button_debounce_t db;
+    button_debounce_init(&db, 0, SETTLE_US);
+    replay_result_t r = {0, 0, -1};
+
+    for (int i = 0; i < count; i++) {
+        int64_t deadline = button_debounce_deadline(&db);
+        if (deadline != BUTTON_DEBOUNCE_NO_DEADLINE && deadline <= trace[i].time_us) {
+            count_event(&r, button_debounce_poll(&db, deadline), deadline);
+        }
+        count_event(&r, button_debounce_poll(&db, trace[i].time_us), trace[i].time_us);
+        count_event(&r, button_debounce_edge(&db, trace[i].level, trace[i].time_us), trace[i].time_us);
+    }
+
+    int64_t deadline = button_debounce_deadline(&db);
+    if (deadline != BUTTON_DEBOUNCE_NO_DEADLINE && deadline <= end_us) {
+        count_event(&r, button_debounce_poll(&db, deadline), deadline);
+    }
+    return r;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_clean_press_and_release(void) {
+    const edge_t trace[] = {
+        {0, 1000000},
+        {1, 1180000},
+    };
+    replay_result_t r = replay(trace, 2, 2000000);
+    TEST_ASSERT_EQUAL(1, r.presses);
+    TEST_ASSERT_EQUAL(1, r.releases);
+    TEST_ASSERT_EQUAL_INT64(1000000, r.first_press_us);
+}
+
+static void test_bouncy_press_is_one_event(void) {
+    const edge_t trace[] = {
+        {0, 2000000}, {1, 2000180}, {0, 2000410}, {1, 2000620},
+        {0, 2000950}, {1, 2001300}, {0, 2001720},
+        {1, 2240000}, {0, 2240350}, {1, 2240900},
+    };
+    replay_result_t r = replay(trace, 10, 3000000);
+    TEST_ASSERT_EQUAL(1, r.presses);
+    TEST_ASSERT_EQUAL(1, r.releases);
+    // Leading edge is accepted without waiting for the bounce to settle
+    TEST_ASSERT_EQUAL_INT64(2000000, r.first_press_us);
+}
+
+static void test_isr_samples_bounced_level(void) {
+    // The first interrupt read the pin after it had bounced back high;
+    // the press must still be recognised from the following edges.
+    const edge_t trace[] = {
+        {1, 500000}, {0, 500220}, {1, 500400}, {0, 500700},
+        {1, 800000},
+    };
+    replay_result_t r = replay(trace, 5, 1500000);
+    TEST_ASSERT_EQUAL(1, r.presses);
+    TEST_ASSERT_EQUAL(1, r.releases);
+}
+
+static void test_bounce_settling_on_other_level(void) {
+    // Accepted as a press on the leading edge, but the contact settled high:
+    // the expired window must report the release.
+    const edge_t trace[] = {
+        {0, 100000}, {1, 100300}, {0, 100500}, {1, 100900},
+    };
+    replay_result_t r = replay(trace, 4, 1000000);
+    TEST_ASSERT_EQUAL(1, r.presses);
+    TEST_ASSERT_EQUAL(1, r.releases);
+}
+
+static void test_rapid_double_press(void) {
+    const edge_t trace[] = {
+        {0, 1000000}, {1, 1000200}, {0, 1000500},
+        {1, 1090000}, {0, 1090300}, {1, 1090800},
+        {0, 1200000}, {1, 1200150}, {0, 1200600},
+        {1, 1300000},
+    };
+    replay_result_t r = replay(trace, 10, 2000000);
+    TEST_ASSERT_EQUAL(2, r.presses);
+    TEST_ASSERT_EQUAL(2, r.releases);
+}
+
+static void test_held_time(void) {
+    button_debounce_t db;
+    button_debounce_init(&db, 0, SETTLE_US);
+
+    TEST_ASSERT_EQUAL_INT64(0, button_debounce_held_us(&db, 1000));
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_PRESS, button_debounce_edge(&db, 0, 1000000));
+    TEST_ASSERT_TRUE(button_debounce_is_pressed(&db));
+    TEST_ASSERT_EQUAL_INT64(5000000, button_debounce_held_us(&db, 6000000));
+
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_NONE, button_debounce_poll(&db, 6000000));
+    TEST_ASSERT_EQUAL(BUTTON_EVENT_RELEASE, button_debounce_edge(&db, 1, 6000000));
+    TEST_ASSERT_EQUAL_INT64(0, button_debounce_held_us(&db, 7000000));
+}
+
+static void test_deadline_only_while_bouncing(void) {
+    button_debounce_t db;
+    button_debounce_init(&db, 0, SETTLE_US);
+
+    TEST_ASSERT_EQUAL_INT64(BUTTON_DEBOUNCE_NO_DEADLINE, button_debounce_deadline(&db));
+    button_debounce_edge(&db, 0, 1000);
+    TEST_ASSERT_EQUAL_INT64(1000 + SETTLE_US, button_debounce_deadline(&db));
+    button_debounce_edge(&db, 1, 2000);
+    TEST_ASSERT_EQUAL_INT64(2000 + SETTLE_US, button_debounce_deadline(&db));
+    button_debounce_poll(&db, 2000 + SETTLE_US);
+    TEST_ASSERT_EQUAL_INT64(BUTTON_DEBOUNCE_NO_DEADLINE, button_debounce_deadline(&db));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_press_and_release);
+    RUN_TEST(test_bouncy_press_is_one_event);
+    RUN_TEST(test_isr_samples_bounced_level);
+    RUN_TEST(test_bounce_settling_on_other_level);
+    RUN_TEST(test_rapid_double_press);
+    RUN_TEST(test_held_time);
+    RUN_TEST(test_deadline_only_while_bouncing);
+    return UNITY_END();
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <unity.h>
+
+#include "clock_util.h"
+
+#define HOUR_S 3600
+
+// POSIX rules as the device stores them
+#define TZ_DENVER    "MST7MDT,M3.2.0/2,M11.1.0/2"
+#define TZ_BERLIN    "CET-1CEST,M3.5.0/2,M10.5.0/3"
+#define TZ_SYDNEY    "<+10>-10<+11>,M10.1.0/2,M4.1.0/3"
+// Santiago switches at 24:00, so the first Sunday of the DST period has no
+// midnight at all
+#define TZ_SANTIAGO  "<-04>4<-03>,M9.1.6/24,M4.1.6/24"
+
+static void use_tz(const char *tz) {
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+static time_t utc(int year, int month, int day, int hour, int minute) {
+    return (time_t)days_from_civil(year, month, day) * 86400 + hour * HOUR_S + minute * 60;
+}
+
+static int local_mday(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return tm.tm_mday;
+}
+
+void setUp(void) {}
+void tearDown(void) {
+    use_tz("UTC0");
+}
+
+static void test_days_from_civil_round_trips(void) {
+    TEST_ASSERT_EQUAL_INT32(0, days_from_civil(1970, 1, 1));
+    TEST_ASSERT_EQUAL_INT32(11016, days_from_civil(2000, 2, 29));
+
+    for (int32_t day = -800; day < 40000; day += 37) {
+        int year, month, dom;
+        civil_from_days(day, &year, &month, &dom);
+        TEST_ASSERT_EQUAL_INT32(day, days_from_civil(year, month, dom));
+    }
+}
+
+static void test_epoch_day_to_date_formats_iso(void) {
+    char date[11];
+    epoch_day_to_date(days_from_civil(2026, 10, 5), date, sizeof(date));
+    TEST_ASSERT_EQUAL_STRING("2026-10-05", date);
+}
+
+static void test_parse_http_date_imf_fixdate(void) {
+    int64_t epoch = 0;
+    TEST_ASSERT_TRUE(parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", &epoch));
+    TEST_ASSERT_EQUAL_INT64(784111777, epoch);
+
+    TEST_ASSERT_TRUE(parse_http_date("Thu, 01 Jan 1970 00:00:00 GMT", &epoch));
+    TEST_ASSERT_EQUAL_INT64(0, epoch);
+
+    // Past 2038, where a 32-bit time_t would wrap
+    TEST_ASSERT_TRUE(parse_http_date("Wed, 29 Feb 2040 23:59:59 GMT", &epoch));
+    TEST_ASSERT_EQUAL_INT64(2214172799, epoch);
+}
+
+static void test_parse_http_date_rejects_other_forms(void) {
+    int64_t epoch = 42;
+    // RFC 850 and asctime are obsolete and not sent by the servers we talk to
+    TEST_ASSERT_FALSE(parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun Nov  6 08:49:37 1994", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 08:49:37 PST", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT trailing", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("", &epoch));
+    TEST_ASSERT_EQUAL_INT64(42, epoch);
+}
+
+static void test_parse_http_date_rejects_out_of_range_fields(void) {
+    int64_t epoch;
+    TEST_ASSERT_FALSE(parse_http_date("Thu, 31 Apr 2026 12:00:00 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 29 Feb 2026 12:00:00 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 00 Nov 1994 08:49:37 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 24:00:00 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 08:60:00 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Nov 1994 08:-1:00 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 Foo 1994 08:49:37 GMT", &epoch));
+    TEST_ASSERT_FALSE(parse_http_date("Sun, 06 anF 1994 08:49:37 GMT", &epoch));
+}
+
+static void test_next_local_midnight_plain_day(void) {
+    use_tz("UTC0");
+    time_t now = utc(2026, 10, 15, 12, 34) + 56;
+    TEST_ASSERT_EQUAL_INT64(utc(2026, 10, 16, 0, 0), next_local_midnight(now));
+
+    // Exactly at midnight the next one is a full day away, so a timer
+    // re-armed on the rollover never fires twice
+    TEST_ASSERT_EQUAL_INT64(utc(2026, 10, 17, 0, 0), next_local_midnight(utc(2026, 10, 16, 0, 0)));
+}
+
+static void test_next_local_midnight_dst_days(void) {
+    use_tz(TZ_DENVER);
+    // 2026-03-08 springs forward: 23 hours from midnight to midnight
+    time_t start = utc(2026, 3, 8, 7, 0);  // 00:00 MST
+    TEST_ASSERT_EQUAL_INT64(start + 23 * HOUR_S, next_local_midnight(start));
+    // 2026-11-01 falls back: 25 hours
+    start = utc(2026, 11, 1, 6, 0);  // 00:00 MDT
+    TEST_ASSERT_EQUAL_INT64(start + 25 * HOUR_S, next_local_midnight(start));
+    // Just before the change, the answer already uses the new offset
+    TEST_ASSERT_EQUAL_INT64(utc(2026, 11, 2, 7, 0), next_local_midnight(utc(2026, 11, 1, 7, 30)));
+
+    use_tz(TZ_BERLIN);
+    start = utc(2026, 3, 28, 23, 0);  // 2026-03-29 00:00 CET
+    TEST_ASSERT_EQUAL_INT64(start + 23 * HOUR_S, next_local_midnight(start));
+    start = utc(2026, 10, 24, 22, 0);  // 2026-10-25 00:00 CEST
+    TEST_ASSERT_EQUAL_INT64(start + 25 * HOUR_S, next_local_midnight(start));
+
+    // Southern hemisphere: DST ends in April
+    use_tz(TZ_SYDNEY);
+    start = utc(2026, 4, 4, 13, 0);  // 2026-04-05 00:00 +11
+    TEST_ASSERT_EQUAL_INT64(start + 25 * HOUR_S, next_local_midnight(start));
+}
+
+static void test_next_local_midnight_skipped_midnight(void) {
+    use_tz(TZ_SANTIAGO);
+    // Saturday 2026-09-05 noon; Sunday starts at the DST change
+    time_t now = utc(2026, 9, 5, 16, 0);
+    time_t midnight = next_local_midnight(now);
+    TEST_ASSERT_TRUE(midnight > now);
+    TEST_ASSERT_EQUAL(5, local_mday(midnight - 1));
+    TEST_ASSERT_EQUAL(6, local_mday(midnight));
+}
+
+// Wherever the clock lands after a step (NTP, HTTP Date, RTC restore or a
+// zone change), the next midnight must be the first day boundary after it
+static void test_next_local_midnight_after_clock_jumps(void) {
+    static const char *zones[] = {"UTC0", TZ_DENVER, TZ_BERLIN, TZ_SYDNEY};
+    srand(1234);
+    for (int z = 0; z < 4; z++) {
+        use_tz(zones[z]);
+        time_t now = utc(2026, 1, 1, 0, 0);
+        for (int i = 0; i < 2000; i++) {
+            // Jumps of up to +-3 days, mostly forward
+            now += (rand() % (4 * 86400)) - 86400;
+            time_t midnight = next_local_midnight(now);
+            TEST_ASSERT_TRUE(midnight > now);
+            TEST_ASSERT_TRUE(midnight - now <= 25 * HOUR_S);
+            TEST_ASSERT_EQUAL(local_mday(now), local_mday(midnight - 1));
+            TEST_ASSERT_NOT_EQUAL(local_mday(midnight - 1), local_mday(midnight));
+        }
+    }
+}
+
+static void test_timezone_rule_from_offset(void) {
+    char rule[32];
+    TEST_ASSERT_TRUE(timezone_rule_from_offset(-25200, rule, sizeof(rule)));
+    TEST_ASSERT_EQUAL_STRING("<-07>7", rule);
+    TEST_ASSERT_TRUE(timezone_rule_from_offset(19800, rule, sizeof(rule)));
+    TEST_ASSERT_EQUAL_STRING("<+0530>-5:30", rule);
+    TEST_ASSERT_TRUE(timezone_rule_from_offset(0, rule, sizeof(rule)));
+    TEST_ASSERT_EQUAL_STRING("<+00>0", rule);
+
+    // The rule moves midnight by the offset
+    use_tz("<+0530>-5:30");
+    TEST_ASSERT_EQUAL_INT64(utc(2026, 10, 15, 18, 30), next_local_midnight(utc(2026, 10, 15, 12, 0)));
+
+    TEST_ASSERT_FALSE(timezone_rule_from_offset(15 * HOUR_S, rule, sizeof(rule)));
+    TEST_ASSERT_FALSE(timezone_rule_from_offset(3600, rule, 5));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_days_from_civil_round_trips);
+    RUN_TEST(test_epoch_day_to_date_formats_iso);
+    RUN_TEST(test_parse_http_date_imf_fixdate);
+    RUN_TEST(test_parse_http_date_rejects_other_forms);
+    RUN_TEST(test_parse_http_date_rejects_out_of_range_fields);
+    RUN_TEST(test_next_local_midnight_plain_day);
+    RUN_TEST(test_next_local_midnight_dst_days);
+    RUN_TEST(test_next_local_midnight_skipped_midnight);
+    RUN_TEST(test_next_local_midnight_after_clock_jumps);
+    RUN_TEST(test_timezone_rule_from_offset);
+    return UNITY_END();
+}
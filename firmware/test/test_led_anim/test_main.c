@@ -0,0 +1,224 @@
+#include <unity.h>
+
+#include <string.h>
+
+#include "led_anim.h"
+
+#define MS 1000LL
+
+static const uint8_t BASE7[7] = {0, 255, 0, 255, 0, 0, 255};
+
+static const led_step_t BLINK_STEPS[] = {
+    {LED_STEP_FILL, 255, 0, 200},
+    {LED_STEP_FILL, 0, 0, 200},
+};
+static const led_pattern_t BLINK = LED_PATTERN(BLINK_STEPS, 50, 3);
+
+static const led_step_t PULSE_STEPS[] = {
+    {LED_STEP_TODAY, 255, 100, 200},
+    {LED_STEP_BASE, 0, 100, 200},
+};
+static const led_pattern_t PULSE = LED_PATTERN(PULSE_STEPS, 10, 0);
+
+static const led_step_t SWEEP_STEPS[] = {
+    {LED_STEP_SWEEP, 255, 0, 1200},
+};
+static const led_pattern_t SWEEP = LED_PATTERN(SWEEP_STEPS, 20, 0);
+
+static const led_step_t COUNTDOWN_STEPS[] = {
+    {LED_STEP_BAR, 255, 0, 7000},
+    {LED_STEP_FILL, 255, 0, 0},
+};
+static const led_pattern_t COUNTDOWN = LED_PATTERN(COUNTDOWN_STEPS, 40, 0);
+
+static const led_step_t DIM_STEPS[] = {
+    {LED_STEP_DIM, 51, 0, 300},
+};
+static const led_pattern_t DIM = LED_PATTERN(DIM_STEPS, 50, 1);
+
+static int64_t render(led_anim_t *a, int64_t now_us, uint8_t out[7], bool *animating) {
+    return led_anim_render(a, now_us, BASE7, out, 7, animating);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_idle_shows_base(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    bool animating = true;
+    TEST_ASSERT_EQUAL_INT64(LED_ANIM_NO_DEADLINE, render(&a, 0, out, &animating));
+    TEST_ASSERT_FALSE(animating);
+    TEST_ASSERT_EQUAL_MEMORY(BASE7, out, 7);
+}
+
+static void test_blink_plays_set_times(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    bool animating;
+    int64_t start = 1000 * MS;
+    TEST_ASSERT_TRUE(led_anim_start(&a, &BLINK, start));
+    TEST_ASSERT_EQUAL_INT64(start + 1200 * MS, led_anim_end_us(&a, &BLINK));
+
+    // Static steps only wake at their ends
+    TEST_ASSERT_EQUAL_INT64(start + 200 * MS, render(&a, start, out, &animating));
+    TEST_ASSERT_TRUE(animating);
+    TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+    TEST_ASSERT_EQUAL_INT64(start + 400 * MS, render(&a, start + 250 * MS, out, NULL));
+    TEST_ASSERT_EQUAL_UINT8(0, out[6]);
+    render(&a, start + 900 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[3]);
+
+    // Third play over: back to the base display
+    TEST_ASSERT_EQUAL_INT64(LED_ANIM_NO_DEADLINE, render(&a, start + 1200 * MS, out, &animating));
+    TEST_ASSERT_FALSE(animating);
+    TEST_ASSERT_EQUAL_MEMORY(BASE7, out, 7);
+    TEST_ASSERT_EQUAL_INT64(LED_ANIM_NO_DEADLINE, led_anim_end_us(&a, &BLINK));
+}
+
+static void test_fades_between_steps(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    led_anim_start(&a, &PULSE, 0);
+
+    // The first step fades in from the base display
+    uint8_t base[7] = {0};
+    TEST_ASSERT_EQUAL_INT64(50 * MS + LED_ANIM_FRAME_MS * MS, led_anim_render(&a, 50 * MS, base, out, 7, NULL));
+    TEST_ASSERT_EQUAL_UINT8(127, out[6]);
+    TEST_ASSERT_EQUAL_UINT8(0, out[5]);
+
+    // Held until the step ends, then fades back down
+    TEST_ASSERT_EQUAL_INT64(200 * MS, led_anim_render(&a, 150 * MS, base, out, 7, NULL));
+    TEST_ASSERT_EQUAL_UINT8(255, out[6]);
+    led_anim_render(&a, 275 * MS, base, out, 7, NULL);
+    TEST_ASSERT_EQUAL_UINT8(64, out[6]);
+
+    // The second play fades in from the last step, not from the base
+    led_anim_render(&a, 450 * MS, base, out, 7, NULL);
+    TEST_ASSERT_EQUAL_UINT8(127, out[6]);
+}
+
+static void test_sweep_runs_there_and_back(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    led_anim_start(&a, &SWEEP, 0);
+
+    // Moving steps ask for the next frame
+    TEST_ASSERT_EQUAL_INT64(LED_ANIM_FRAME_MS * MS, render(&a, 0, out, NULL));
+    TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, out[1]);
+
+    // 100 ms per LED; half way between two LEDs both are half lit
+    render(&a, 250 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(127, out[2]);
+    TEST_ASSERT_EQUAL_UINT8(127, out[3]);
+
+    render(&a, 600 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[6]);
+    render(&a, 700 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[5]);
+    TEST_ASSERT_EQUAL_UINT8(0, out[6]);
+
+    // Loops
+    render(&a, 1200 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+}
+
+static void test_bar_fills_then_holds(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    led_anim_start(&a, &COUNTDOWN, 0);
+
+    // One LED per second, the next one fading in
+    render(&a, 2500 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+    TEST_ASSERT_EQUAL_UINT8(255, out[1]);
+    TEST_ASSERT_EQUAL_UINT8(127, out[2]);
+    TEST_ASSERT_EQUAL_UINT8(0, out[3]);
+
+    // Held full with nothing left to time
+    TEST_ASSERT_EQUAL_INT64(LED_ANIM_NO_DEADLINE, render(&a, 60000 * MS, out, NULL));
+    for (int i = 0; i < 7; i++) TEST_ASSERT_EQUAL_UINT8(255, out[i]);
+    TEST_ASSERT_EQUAL_INT64(LED_ANIM_NO_DEADLINE, led_anim_end_us(&a, &COUNTDOWN));
+
+    led_anim_stop(&a, &COUNTDOWN);
+    render(&a, 60000 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_MEMORY(BASE7, out, 7);
+}
+
+static void test_priority(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    led_anim_start(&a, &COUNTDOWN, 0);
+    led_anim_start(&a, &SWEEP, 0);
+
+    // The countdown outranks the sweep whichever started last
+    render(&a, 0, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(0, out[0]);
+    led_anim_stop(&a, &COUNTDOWN);
+    render(&a, 0, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+
+    // Equal priorities: the latest start wins, the other shows once it ends
+    led_anim_start(&a, &BLINK, 0);
+    led_anim_start(&a, &DIM, 100 * MS);
+    render(&a, 150 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(51, out[1]);
+    render(&a, 650 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(0, out[1]);   // blink, second step
+}
+
+static void test_restart_and_capacity(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t out[7];
+    led_anim_start(&a, &BLINK, 0);
+    led_anim_start(&a, &BLINK, 300 * MS);
+    TEST_ASSERT_EQUAL_INT64(1500 * MS, led_anim_end_us(&a, &BLINK));
+    render(&a, 300 * MS, out, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[0]);
+
+    static led_pattern_t others[LED_ANIM_MAX_ACTIVE];
+    for (int i = 0; i < LED_ANIM_MAX_ACTIVE - 1; i++) {
+        others[i] = SWEEP;
+        TEST_ASSERT_TRUE(led_anim_start(&a, &others[i], 0));
+    }
+    others[LED_ANIM_MAX_ACTIVE - 1] = SWEEP;
+    TEST_ASSERT_FALSE(led_anim_start(&a, &others[LED_ANIM_MAX_ACTIVE - 1], 0));
+    TEST_ASSERT_TRUE(led_anim_start(&a, &BLINK, 400 * MS));
+}
+
+static void test_long_strip(void) {
+    led_anim_t a;
+    led_anim_init(&a);
+    uint8_t base[52] = {0};
+    uint8_t out[52];
+    led_anim_start(&a, &COUNTDOWN, 0);
+    led_anim_render(&a, 3500 * MS, base, out, 52, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[25]);
+    TEST_ASSERT_EQUAL_UINT8(0, out[26]);
+
+    led_anim_stop(&a, &COUNTDOWN);
+    led_anim_start(&a, &SWEEP, 0);
+    led_anim_render(&a, 600 * MS, base, out, 52, NULL);
+    TEST_ASSERT_EQUAL_UINT8(255, out[51]);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_shows_base);
+    RUN_TEST(test_blink_plays_set_times);
+    RUN_TEST(test_fades_between_steps);
+    RUN_TEST(test_sweep_runs_there_and_back);
+    RUN_TEST(test_bar_fills_then_holds);
+    RUN_TEST(test_priority);
+    RUN_TEST(test_restart_and_capacity);
+    RUN_TEST(test_long_strip);
+    return UNITY_END();
+}
@@ -0,0 +1,49 @@
+#include <unity.h>
+
+#include "led_route.h"
+
+#define DUTY_MAX 8191
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_off_and_full_are_plain_levels(void) {
+    const uint32_t channels[6] = {0, 0, 8191, 0, 0, 8191};
+    TEST_ASSERT_EQUAL(LED_ROUTE_OFF, led_route_pick(0, channels, 6, DUTY_MAX));
+    TEST_ASSERT_EQUAL(LED_ROUTE_ON, led_route_pick(DUTY_MAX, channels, 6, DUTY_MAX));
+}
+
+static void test_follows_channel_at_same_duty(void) {
+    const uint32_t channels[6] = {0, 1100, 0, 0, 0, 1200};
+    TEST_ASSERT_EQUAL(5, led_route_pick(1200, channels, 6, DUTY_MAX));
+}
+
+static void test_dimmed_led_with_every_channel_dark_stays_lit(void) {
+    // Night brightness, only the shared LED is lit
+    const uint32_t channels[6] = {0};
+    TEST_ASSERT_EQUAL(LED_ROUTE_ON, led_route_pick(1, channels, 6, DUTY_MAX));
+    TEST_ASSERT_EQUAL(LED_ROUTE_ON, led_route_pick(300, channels, 6, DUTY_MAX));
+}
+
+static void test_dark_channel_is_never_borrowed(void) {
+    // The dark channels are closer than the lit one, but would turn it off
+    const uint32_t channels[6] = {0, 0, 0, 0, 0, 6000};
+    TEST_ASSERT_EQUAL(5, led_route_pick(100, channels, 6, DUTY_MAX));
+}
+
+static void test_nearest_lit_channel_or_full(void) {
+    const uint32_t channels[3] = {500, 3000, 7000};
+    TEST_ASSERT_EQUAL(0, led_route_pick(900, channels, 3, DUTY_MAX));
+    TEST_ASSERT_EQUAL(1, led_route_pick(2500, channels, 3, DUTY_MAX));
+    TEST_ASSERT_EQUAL(LED_ROUTE_ON, led_route_pick(8000, channels, 3, DUTY_MAX));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_off_and_full_are_plain_levels);
+    RUN_TEST(test_follows_channel_at_same_duty);
+    RUN_TEST(test_dimmed_led_with_every_channel_dark_stays_lit);
+    RUN_TEST(test_dark_channel_is_never_borrowed);
+    RUN_TEST(test_nearest_lit_channel_or_full);
+    return UNITY_END();
+}
@@ -0,0 +1,241 @@
+#include <unity.h>
+
+#include <string.h>
+
+#include "press_coalescer.h"
+#include "press_journal.h"
+
+// Toggle sequences replayed the way network_task drives the coalescer:
+// poll when the deadline passes, then feed the next toggle. Every released
+// operation stands for one network request.
+
+#define SETTLE_US ((int64_t)PRESS_SETTLE_MS * 1000)
+#define MAX_OPS 16
+
+typedef struct {
+    int32_t day;
+    int64_t time_us;
+} toggle_t;
+
+typedef struct {
+    int count;
+    press_op_t ops[MAX_OPS];
+} replay_result_t;
+
+static void record(replay_result_t *r, const press_op_t *op) {
+    TEST_ASSERT_TRUE(r->count < MAX_OPS);
+    r->ops[r->count++] = *op;
+}
+
+// Each toggle flips the bit of its day, starting from initial_state
+static replay_result_t replay(const toggle_t *toggles, int count, bool initial_state) {
+    press_coalescer_t c;
+    press_coalescer_init(&c, SETTLE_US);
+    replay_result_t r = {0};
+    bool state = initial_state;
+    press_op_t op;
+
+    for (int i = 0; i < count; i++) {
+        int64_t deadline = press_coalescer_deadline(&c);
+        if (deadline != PRESS_COALESCER_NO_DEADLINE && deadline <= toggles[i].time_us &&
+            press_coalescer_poll(&c, deadline, &op)) {
+            record(&r, &op);
+        }
+        if (i > 0 && toggles[i].day != toggles[i - 1].day) {
+            state = false;  // a new day starts unpressed
+        }
+        state = !state;
+        if (press_coalescer_add(&c, toggles[i].day, state, toggles[i].time_us, &op)) {
+            record(&r, &op);
+        }
+    }
+
+    int64_t deadline = press_coalescer_deadline(&c);
+    if (deadline != PRESS_COALESCER_NO_DEADLINE && press_coalescer_poll(&c, deadline, &op)) {
+        record(&r, &op);
+    }
+    return r;
+}
+
+static void fill_rapid(toggle_t *toggles, int n, int64_t start_us, int64_t gap_us) {
+    for (int i = 0; i < n; i++) {
+        toggles[i].day = 20741;
+        toggles[i].time_us = start_us + i * gap_us;
+    }
+}
+
+// Journal the released operations the way send_press_op() does. Every
+// pending record goes out in the next request, so the pending count is
+// what a burst costs on the network.
+
+#define JOURNAL_SECTOR_SIZE 256
+
+static uint8_t s_flash_mem[JOURNAL_SECTOR_SIZE * 2];
+
+static int ram_read(void *ctx, uint32_t offset, void *buf, uint32_t len) {
+    memcpy(buf, s_flash_mem + offset, len);
+    return 0;
+}
+
+static int ram_write(void *ctx, uint32_t offset, const void *buf, uint32_t len) {
+    const uint8_t *src = buf;
+    for (uint32_t i = 0; i < len; i++) s_flash_mem[offset + i] &= src[i];
+    return 0;
+}
+
+static int ram_erase(void *ctx, uint32_t sector) {
+    memset(s_flash_mem + sector * JOURNAL_SECTOR_SIZE, 0xFF, JOURNAL_SECTOR_SIZE);
+    return 0;
+}
+
+static const press_journal_flash_t s_ram_flash = {
+    .sector_size = JOURNAL_SECTOR_SIZE,
+    .sector_count = 2,
+    .read = ram_read,
+    .write = ram_write,
+    .erase_sector = ram_erase,
+};
+
+static void journal_ops(press_journal_t *j, const replay_result_t *r) {
+    press_journal_entry_t entry;
+    for (int i = 0; i < r->count; i++) {
+        TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK,
+                          press_journal_append(j, r->ops[i].day, r->ops[i].state, &entry));
+    }
+}
+
+void setUp(void) {
+    memset(s_flash_mem, 0xFF, sizeof(s_flash_mem));
+}
+
+void tearDown(void) {}
+
+static void test_single_press_is_one_op(void) {
+    const toggle_t toggles[] = {{20741, 1000000}};
+    replay_result_t r = replay(toggles, 1, false);
+    TEST_ASSERT_EQUAL(1, r.count);
+    TEST_ASSERT_TRUE(r.ops[0].state);
+    TEST_ASSERT_EQUAL(1, r.ops[0].toggles);
+    TEST_ASSERT_EQUAL_INT64(1000000, r.ops[0].first_us);
+}
+
+static void test_odd_rapid_toggles_are_one_op(void) {
+    for (int n = 1; n <= 15; n += 2) {
+        toggle_t toggles[15];
+        fill_rapid(toggles, n, 1000000, 300000);
+        replay_result_t r = replay(toggles, n, false);
+        TEST_ASSERT_EQUAL(1, r.count);
+        TEST_ASSERT_TRUE(r.ops[0].state);
+        TEST_ASSERT_EQUAL(n, r.ops[0].toggles);
+    }
+}
+
+static void test_even_rapid_toggles_cancel_out(void) {
+    for (int n = 2; n <= 16; n += 2) {
+        toggle_t toggles[16];
+        fill_rapid(toggles, n, 1000000, 300000);
+        TEST_ASSERT_EQUAL(0, replay(toggles, n, false).count);
+        TEST_ASSERT_EQUAL(0, replay(toggles, n, true).count);
+    }
+}
+
+static void test_on_off_on_sends_final_state(void) {
+    // ON -> OFF -> ON within a second
+    const toggle_t toggles[] = {{20741, 0}, {20741, 400000}, {20741, 900000}};
+    replay_result_t r = replay(toggles, 3, false);
+    TEST_ASSERT_EQUAL(1, r.count);
+    TEST_ASSERT_TRUE(r.ops[0].state);
+
+    // Starting from ON the same burst ends OFF
+    r = replay(toggles, 3, true);
+    TEST_ASSERT_EQUAL(1, r.count);
+    TEST_ASSERT_FALSE(r.ops[0].state);
+}
+
+static void test_window_restarts_on_each_toggle(void) {
+    // Spans 4 x 1.4 s overall, but no gap reaches the settle window
+    toggle_t toggles[5];
+    fill_rapid(toggles, 5, 0, SETTLE_US - 100000);
+    replay_result_t r = replay(toggles, 5, false);
+    TEST_ASSERT_EQUAL(1, r.count);
+    TEST_ASSERT_EQUAL(5, r.ops[0].toggles);
+}
+
+static void test_spaced_toggles_are_separate_ops(void) {
+    toggle_t toggles[3];
+    fill_rapid(toggles, 3, 0, SETTLE_US);
+    replay_result_t r = replay(toggles, 3, false);
+    TEST_ASSERT_EQUAL(3, r.count);
+    TEST_ASSERT_TRUE(r.ops[0].state);
+    TEST_ASSERT_FALSE(r.ops[1].state);
+    TEST_ASSERT_TRUE(r.ops[2].state);
+}
+
+static void test_day_change_releases_pending_op(void) {
+    // Pressed just before midnight and again just after
+    const toggle_t toggles[] = {{20740, 1000000}, {20741, 1200000}};
+    replay_result_t r = replay(toggles, 2, false);
+    TEST_ASSERT_EQUAL(2, r.count);
+    TEST_ASSERT_EQUAL_INT32(20740, r.ops[0].day);
+    TEST_ASSERT_TRUE(r.ops[0].state);
+    TEST_ASSERT_EQUAL_INT32(20741, r.ops[1].day);
+    TEST_ASSERT_TRUE(r.ops[1].state);
+}
+
+static void test_poll_before_deadline_holds_op(void) {
+    press_coalescer_t c;
+    press_coalescer_init(&c, SETTLE_US);
+    press_op_t op;
+
+    TEST_ASSERT_FALSE(press_coalescer_add(&c, 20741, true, 1000, &op));
+    TEST_ASSERT_EQUAL_INT64(1000 + SETTLE_US, press_coalescer_deadline(&c));
+    TEST_ASSERT_FALSE(press_coalescer_poll(&c, 1000 + SETTLE_US - 1, &op));
+    TEST_ASSERT_TRUE(press_coalescer_poll(&c, 1000 + SETTLE_US, &op));
+    TEST_ASSERT_FALSE(press_coalescer_poll(&c, 2000 + SETTLE_US, &op));
+}
+
+static void test_burst_journals_its_settled_state_once(void) {
+    press_journal_t j;
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_mount(&j, &s_ram_flash));
+
+    toggle_t toggles[7];
+    fill_rapid(toggles, 7, 1000000, 200000);
+    journal_ops(&j, &(replay_result_t){0});
+    replay_result_t r = replay(toggles, 7, false);
+    journal_ops(&j, &r);
+
+    press_journal_entry_t pending[8];
+    TEST_ASSERT_EQUAL(1, press_journal_pending_count(&j));
+    TEST_ASSERT_EQUAL(1, press_journal_read_pending(&j, pending, 8));
+    TEST_ASSERT_EQUAL_INT32(20741, pending[0].day);
+    TEST_ASSERT_TRUE(pending[0].state);
+}
+
+static void test_cancelled_burst_journals_nothing(void) {
+    press_journal_t j;
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_mount(&j, &s_ram_flash));
+
+    toggle_t toggles[6];
+    fill_rapid(toggles, 6, 1000000, 200000);
+    replay_result_t r = replay(toggles, 6, true);
+    journal_ops(&j, &r);
+
+    // Nothing pending, so the burst costs no request either
+    TEST_ASSERT_EQUAL(0, press_journal_pending_count(&j));
+    TEST_ASSERT_EQUAL(1, j.next_seq);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_press_is_one_op);
+    RUN_TEST(test_odd_rapid_toggles_are_one_op);
+    RUN_TEST(test_even_rapid_toggles_cancel_out);
+    RUN_TEST(test_on_off_on_sends_final_state);
+    RUN_TEST(test_window_restarts_on_each_toggle);
+    RUN_TEST(test_spaced_toggles_are_separate_ops);
+    RUN_TEST(test_day_change_releases_pending_op);
+    RUN_TEST(test_poll_before_deadline_holds_op);
+    RUN_TEST(test_burst_journals_its_settled_state_once);
+    RUN_TEST(test_cancelled_burst_journals_nothing);
+    return UNITY_END();
+}
@@ -0,0 +1,299 @@
+#include <unity.h>
+
+#include <string.h>
+
+#include "clock_util.h"
+#include "press_history.h"
+
+static uint32_t rng_next(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// Reference model: the same history as plain arrays, shifted a day at a time
+typedef struct {
+    int32_t day;
+    bool pressed[PRESS_HISTORY_DAYS];
+    uint16_t minute[PRESS_HISTORY_DAYS];
+} model_t;
+
+static void model_advance(model_t *m, int32_t today) {
+    while (m->day < today) {
+        memmove(&m->pressed[1], &m->pressed[0], (PRESS_HISTORY_DAYS - 1) * sizeof(bool));
+        memmove(&m->minute[1], &m->minute[0], (PRESS_HISTORY_DAYS - 1) * sizeof(uint16_t));
+        m->pressed[0] = false;
+        m->minute[0] = PRESS_HISTORY_NO_MINUTE;
+        m->day++;
+    }
+}
+
+static void assert_matches(const model_t *m, const press_history_t *h) {
+    TEST_ASSERT_EQUAL_INT32(m->day, h->day);
+    for (int i = 0; i < PRESS_HISTORY_DAYS; i++) {
+        uint16_t minute;
+        bool pressed = press_history_get(h, i, &minute);
+        TEST_ASSERT_EQUAL_MESSAGE(m->pressed[i], pressed, "pressed");
+        TEST_ASSERT_EQUAL_UINT16_MESSAGE(m->minute[i], minute, "minute");
+    }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_blob_layout(void) {
+    press_history_t h;
+    TEST_ASSERT_EQUAL(60 + 2 * PRESS_HISTORY_DAYS, sizeof(h));
+
+    press_history_init(&h, 20000);
+    press_history_set(&h, 9, true, 0x0102);
+    const uint8_t *raw = (const uint8_t *)&h;
+    TEST_ASSERT_EQUAL_HEX8(PRESS_HISTORY_VERSION, raw[0]);
+    TEST_ASSERT_EQUAL_UINT16(sizeof(h), raw[2] | raw[3] << 8);
+    TEST_ASSERT_EQUAL_UINT16(PRESS_HISTORY_DAYS, raw[4] | raw[5] << 8);
+    TEST_ASSERT_EQUAL_HEX8(0x02, raw[12 + 1]);   // day 9: byte 1, bit 1
+    TEST_ASSERT_EQUAL_HEX8(0x02, raw[60 + 18]);  // little-endian minute
+    TEST_ASSERT_EQUAL_HEX8(0x01, raw[60 + 19]);
+}
+
+static void test_set_and_get(void) {
+    press_history_t h;
+    press_history_init(&h, 20000);
+    uint16_t minute;
+
+    TEST_ASSERT_FALSE(press_history_get(&h, 0, &minute));
+    TEST_ASSERT_EQUAL_UINT16(PRESS_HISTORY_NO_MINUTE, minute);
+
+    TEST_ASSERT_TRUE(press_history_set(&h, 0, true, 8 * 60 + 15));
+    TEST_ASSERT_TRUE(press_history_get(&h, 0, &minute));
+    TEST_ASSERT_EQUAL_UINT16(8 * 60 + 15, minute);
+
+    // Unpressing forgets the minute
+    press_history_set(&h, 0, false, 600);
+    TEST_ASSERT_FALSE(press_history_get(&h, 0, &minute));
+    TEST_ASSERT_EQUAL_UINT16(PRESS_HISTORY_NO_MINUTE, minute);
+
+    TEST_ASSERT_FALSE(press_history_set(&h, -1, true, 0));
+    TEST_ASSERT_FALSE(press_history_set(&h, PRESS_HISTORY_DAYS, true, 0));
+    TEST_ASSERT_FALSE(press_history_get(&h, PRESS_HISTORY_DAYS, NULL));
+}
+
+static void test_advance_across_year_end(void) {
+    press_history_t h;
+    press_history_init(&h, days_from_civil(2027, 12, 30));
+    press_history_set(&h, 0, true, 100);
+    press_history_set(&h, 1, true, 200);
+
+    TEST_ASSERT_EQUAL_INT32(3, press_history_advance(&h, days_from_civil(2028, 1, 2)));
+    uint16_t minute;
+    TEST_ASSERT_TRUE(press_history_get(&h, 3, &minute));
+    TEST_ASSERT_EQUAL_UINT16(100, minute);
+    TEST_ASSERT_TRUE(press_history_get(&h, 4, &minute));
+    TEST_ASSERT_EQUAL_UINT16(200, minute);
+    TEST_ASSERT_EQUAL(2, press_history_count(&h, PRESS_HISTORY_DAYS));
+}
+
+static void test_full_year_is_kept(void) {
+    // Every day of the leap year 2028, then a day into 2029
+    press_history_t h;
+    press_history_init(&h, days_from_civil(2028, 1, 1));
+    for (int32_t day = days_from_civil(2028, 1, 1); day <= days_from_civil(2028, 12, 31); day++) {
+        press_history_advance(&h, day);
+        press_history_set(&h, 0, true, 720);
+    }
+    press_history_advance(&h, days_from_civil(2029, 1, 1));
+    TEST_ASSERT_EQUAL(366, press_history_count(&h, PRESS_HISTORY_DAYS));
+    TEST_ASSERT_TRUE(press_history_get(&h, 366, NULL));
+    TEST_ASSERT_FALSE(press_history_get(&h, 367, NULL));
+}
+
+static void test_long_absence_clears(void) {
+    press_history_t h;
+    press_history_init(&h, 20000);
+    press_history_set(&h, 0, true, 1);
+    TEST_ASSERT_EQUAL_INT32(PRESS_HISTORY_DAYS, press_history_advance(&h, 20000 + PRESS_HISTORY_DAYS));
+    TEST_ASSERT_EQUAL(0, press_history_count(&h, PRESS_HISTORY_DAYS));
+    TEST_ASSERT_EQUAL_INT32(20000 + PRESS_HISTORY_DAYS, h.day);
+}
+
+static void test_unknown_and_backward_days(void) {
+    press_history_t h;
+    press_history_init(&h, STREAK_NO_DAY);
+    press_history_set(&h, 0, true, PRESS_HISTORY_NO_MINUTE);
+    TEST_ASSERT_EQUAL_INT32(0, press_history_advance(&h, 20000));
+    TEST_ASSERT_EQUAL_INT32(20000, h.day);
+    TEST_ASSERT_TRUE(press_history_get(&h, 0, NULL));
+
+    TEST_ASSERT_EQUAL_INT32(0, press_history_advance(&h, 19990));
+    TEST_ASSERT_EQUAL_INT32(20000, h.day);
+    TEST_ASSERT_TRUE(press_history_get(&h, 0, NULL));
+}
+
+static void test_streak_round_trip(void) {
+    streak_t s;
+    streak_init(&s, 0x55, 20000);
+    press_history_t h;
+    press_history_from_streak(&h, &s);
+    TEST_ASSERT_TRUE(press_history_get(&h, 0, NULL));   // bit 6
+    TEST_ASSERT_FALSE(press_history_get(&h, 1, NULL));  // bit 5
+    TEST_ASSERT_TRUE(press_history_get(&h, 6, NULL));   // bit 0
+
+    streak_t back = press_history_streak(&h);
+    TEST_ASSERT_EQUAL_HEX8(0x55, back.bits);
+    TEST_ASSERT_EQUAL_INT32(20000, back.day);
+
+    // The streak view follows the history through a shift
+    press_history_advance(&h, 20002);
+    streak_advance(&s, 20002);
+    TEST_ASSERT_EQUAL_HEX8(s.bits, press_history_streak(&h).bits);
+}
+
+static void test_decode(void) {
+    press_history_t h, loaded;
+    press_history_init(&h, 20000);
+    press_history_set(&h, 5, true, 42);
+
+    press_history_init(&loaded, 1);
+    TEST_ASSERT_TRUE(press_history_decode(&loaded, &h, sizeof(h)));
+    TEST_ASSERT_EQUAL_MEMORY(&h, &loaded, sizeof(h));
+
+    // Wrong size, unknown version and a different day count are refused
+    press_history_init(&loaded, 1);
+    TEST_ASSERT_FALSE(press_history_decode(&loaded, &h, sizeof(h) - 2));
+    TEST_ASSERT_FALSE(press_history_decode(&loaded, &h, 0));
+    press_history_t bad = h;
+    bad.version = PRESS_HISTORY_VERSION + 1;
+    TEST_ASSERT_FALSE(press_history_decode(&loaded, &bad, sizeof(bad)));
+    bad = h;
+    bad.days = PRESS_HISTORY_DAYS - 8;
+    TEST_ASSERT_FALSE(press_history_decode(&loaded, &bad, sizeof(bad)));
+    bad = h;
+    bad.size = sizeof(bad) - 2;
+    TEST_ASSERT_FALSE(press_history_decode(&loaded, &bad, sizeof(bad)));
+    TEST_ASSERT_EQUAL_INT32(1, loaded.day);
+}
+
+static void test_decode_version_1(void) {
+    press_history_t h, loaded;
+    press_history_init(&h, 20000);
+    press_history_set(&h, 0, true, 8 * 60);
+    press_history_set(&h, 383, true, 23 * 60);
+
+    // The same history in the version 1 layout, without the size field
+    uint8_t v1[56 + 2 * PRESS_HISTORY_DAYS];
+    memset(v1, 0, sizeof(v1));
+    v1[0] = 1;
+    uint16_t days = PRESS_HISTORY_DAYS;
+    memcpy(&v1[2], &days, sizeof(days));
+    memcpy(&v1[4], &h.day, sizeof(h.day));
+    memcpy(&v1[8], h.pressed, sizeof(h.pressed));
+    memcpy(&v1[56], h.minute, sizeof(h.minute));
+
+    TEST_ASSERT_TRUE(press_history_decode(&loaded, v1, sizeof(v1)));
+    TEST_ASSERT_EQUAL_MEMORY(&h, &loaded, sizeof(h));
+    TEST_ASSERT_EQUAL(PRESS_HISTORY_VERSION, loaded.version);
+    TEST_ASSERT_FALSE(press_history_decode(&loaded, v1, sizeof(v1) - 2));
+}
+
+static void test_hash_tracks_contents(void) {
+    press_history_t h;
+    press_history_init(&h, 20000);
+    uint32_t saved = press_history_hash(&h);
+
+    // A toggle and its undo leave nothing to write
+    press_history_set(&h, 0, true, 600);
+    TEST_ASSERT_NOT_EQUAL(saved, press_history_hash(&h));
+    press_history_set(&h, 0, false, PRESS_HISTORY_NO_MINUTE);
+    TEST_ASSERT_EQUAL_UINT32(saved, press_history_hash(&h));
+
+    // Only the minute or only the day changing is a change
+    press_history_set(&h, 3, true, 600);
+    saved = press_history_hash(&h);
+    press_history_set(&h, 3, true, 601);
+    TEST_ASSERT_NOT_EQUAL(saved, press_history_hash(&h));
+    press_history_set(&h, 3, true, 600);
+    press_history_advance(&h, 20001);
+    TEST_ASSERT_NOT_EQUAL(saved, press_history_hash(&h));
+}
+
+static void test_merge(void) {
+    press_history_t h;
+    press_history_init(&h, 20000);
+    press_history_set(&h, 0, true, 480);   // only here
+    press_history_set(&h, 2, true, 500);   // on both sides
+    press_history_set(&h, 40, true, 600);  // outside the compared window
+    const uint8_t remote[2] = {0x06, 0x01};  // days 1, 2 and 8
+    int32_t changed[4];
+
+    // Local wins: differences are reported, nothing changes
+    TEST_ASSERT_EQUAL(3, press_history_merge(&h, remote, 16, false, changed, 4));
+    TEST_ASSERT_EQUAL_INT32(0, changed[0]);
+    TEST_ASSERT_EQUAL_INT32(1, changed[1]);
+    TEST_ASSERT_EQUAL_INT32(8, changed[2]);
+    TEST_ASSERT_TRUE(press_history_get(&h, 0, NULL));
+    TEST_ASSERT_FALSE(press_history_get(&h, 1, NULL));
+
+    // Remote wins: local takes its state, keeping minutes it agrees with
+    TEST_ASSERT_EQUAL(3, press_history_merge(&h, remote, 16, true, changed, 1));
+    TEST_ASSERT_EQUAL_INT32(0, changed[0]);
+    uint16_t minute;
+    TEST_ASSERT_FALSE(press_history_get(&h, 0, NULL));
+    TEST_ASSERT_TRUE(press_history_get(&h, 1, &minute));
+    TEST_ASSERT_EQUAL_UINT16(PRESS_HISTORY_NO_MINUTE, minute);
+    TEST_ASSERT_TRUE(press_history_get(&h, 2, &minute));
+    TEST_ASSERT_EQUAL_UINT16(500, minute);
+    TEST_ASSERT_TRUE(press_history_get(&h, 8, NULL));
+    TEST_ASSERT_TRUE(press_history_get(&h, 40, NULL));
+
+    TEST_ASSERT_EQUAL(0, press_history_merge(&h, remote, 16, true, changed, 4));
+}
+
+static void test_matches_model(void) {
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        uint32_t rng = seed;
+        press_history_t h;
+        static model_t m;
+        press_history_init(&h, 20000);
+        m.day = 20000;
+        for (int i = 0; i < PRESS_HISTORY_DAYS; i++) {
+            m.pressed[i] = false;
+            m.minute[i] = PRESS_HISTORY_NO_MINUTE;
+        }
+
+        for (int op = 0; op < 200; op++) {
+            uint32_t r = rng_next(&rng) % 10;
+            if (r < 6) {
+                int32_t ago = (int32_t)(rng_next(&rng) % PRESS_HISTORY_DAYS);
+                bool pressed = rng_next(&rng) & 1;
+                uint16_t minute = (uint16_t)(rng_next(&rng) % 1440);
+                press_history_set(&h, ago, pressed, minute);
+                m.pressed[ago] = pressed;
+                m.minute[ago] = pressed ? minute : PRESS_HISTORY_NO_MINUTE;
+            } else {
+                // Mostly short gaps, some past the end of the history
+                int32_t gap = (int32_t)(rng_next(&rng) % (r == 9 ? 500 : 20));
+                press_history_advance(&h, h.day + gap);
+                model_advance(&m, m.day + gap);
+            }
+        }
+        assert_matches(&m, &h);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_blob_layout);
+    RUN_TEST(test_set_and_get);
+    RUN_TEST(test_advance_across_year_end);
+    RUN_TEST(test_full_year_is_kept);
+    RUN_TEST(test_long_absence_clears);
+    RUN_TEST(test_unknown_and_backward_days);
+    RUN_TEST(test_streak_round_trip);
+    RUN_TEST(test_decode);
+    RUN_TEST(test_decode_version_1);
+    RUN_TEST(test_hash_tracks_contents);
+    RUN_TEST(test_merge);
+    RUN_TEST(test_matches_model);
+    return UNITY_END();
+}
@@ -0,0 +1,385 @@
+#include <unity.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "press_journal.h"
+
+// Simulated NOR flash: programming can only clear bits, erase sets a whole
+// sector to 0xFF. A byte budget models power loss - once it runs out, the
+// operation in progress is left half done and every later access fails
+// until the test "reboots" the device.
+
+#define SECTOR_SIZE  256
+#define SECTOR_COUNT 4
+#define SLOTS ((SECTOR_SIZE - PRESS_JOURNAL_HEADER_SIZE) / PRESS_JOURNAL_RECORD_SIZE)
+#define CAPACITY (SLOTS * SECTOR_COUNT)
+
+typedef struct {
+    uint8_t mem[SECTOR_SIZE * SECTOR_COUNT];
+    long budget;  // byte operations until power loss, -1 = unlimited
+    bool dead;
+    uint32_t rng;
+    uint32_t erases[SECTOR_COUNT];
+    uint32_t reads;
+} sim_flash_t;
+
+static uint32_t rng_next(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static bool consume(sim_flash_t *f) {
+    if (f->dead) return false;
+    if (f->budget < 0) return true;
+    if (f->budget == 0) {
+        f->dead = true;
+        return false;
+    }
+    f->budget--;
+    return true;
+}
+
+static int sim_read(void *ctx, uint32_t offset, void *buf, uint32_t len) {
+    sim_flash_t *f = ctx;
+    if (f->dead) return -1;
+    f->reads++;
+    memcpy(buf, f->mem + offset, len);
+    return 0;
+}
+
+static int sim_write(void *ctx, uint32_t offset, const void *buf, uint32_t len) {
+    sim_flash_t *f = ctx;
+    const uint8_t *src = buf;
+    if (f->dead) return -1;
+    for (uint32_t i = 0; i < len; i++) {
+        if (!consume(f)) {
+            // Torn byte: only some of its bits got programmed
+            f->mem[offset + i] &= (uint8_t)(src[i] | rng_next(&f->rng));
+            return -1;
+        }
+        f->mem[offset + i] &= src[i];
+    }
+    return 0;
+}
+
+static int sim_erase(void *ctx, uint32_t sector) {
+    sim_flash_t *f = ctx;
+    uint8_t *base = f->mem + sector * SECTOR_SIZE;
+    if (f->dead) return -1;
+    if (!consume(f)) {
+        // Interrupted erase: random bytes made it back to 0xFF
+        for (int i = 0; i < SECTOR_SIZE; i++) {
+            if (rng_next(&f->rng) & 1) base[i] = 0xFF;
+        }
+        return -1;
+    }
+    memset(base, 0xFF, SECTOR_SIZE);
+    f->erases[sector]++;
+    return 0;
+}
+
+static sim_flash_t s_flash;
+static press_journal_flash_t s_ops;
+static press_journal_t s_journal;
+
+static void flash_reset(uint32_t seed) {
+    memset(s_flash.mem, 0xFF, sizeof(s_flash.mem));
+    memset(s_flash.erases, 0, sizeof(s_flash.erases));
+    s_flash.reads = 0;
+    s_flash.budget = -1;
+    s_flash.dead = false;
+    s_flash.rng = seed ? seed : 1;
+    s_ops = (press_journal_flash_t){
+        .ctx = &s_flash,
+        .sector_size = SECTOR_SIZE,
+        .sector_count = SECTOR_COUNT,
+        .read = sim_read,
+        .write = sim_write,
+        .erase_sector = sim_erase,
+    };
+}
+
+static void reboot(void) {
+    s_flash.budget = -1;
+    s_flash.dead = false;
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_mount(&s_journal, &s_ops));
+}
+
+void setUp(void) {
+    flash_reset(1);
+}
+
+void tearDown(void) {}
+
+static void test_append_read_ack(void) {
+    reboot();
+    TEST_ASSERT_EQUAL(0, press_journal_pending_count(&s_journal));
+
+    press_journal_entry_t e;
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, 20000, true, &e));
+    TEST_ASSERT_EQUAL(1, e.seq);
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, 20000, false, &e));
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, 20001, true, &e));
+    TEST_ASSERT_EQUAL(3, e.seq);
+
+    press_journal_entry_t pending[8];
+    TEST_ASSERT_EQUAL(3, press_journal_read_pending(&s_journal, pending, 8));
+    TEST_ASSERT_EQUAL(1, pending[0].seq);
+    TEST_ASSERT_TRUE(pending[0].state);
+    TEST_ASSERT_EQUAL(20001, pending[2].day);
+
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_ack(&s_journal, 2));
+    TEST_ASSERT_EQUAL(1, press_journal_pending_count(&s_journal));
+    TEST_ASSERT_EQUAL(1, press_journal_read_pending(&s_journal, pending, 8));
+    TEST_ASSERT_EQUAL(3, pending[0].seq);
+}
+
+static void test_state_survives_remount(void) {
+    reboot();
+    press_journal_entry_t e;
+    for (int i = 0; i < 5; i++) {
+        press_journal_append(&s_journal, 100 + i, i & 1, &e);
+    }
+    press_journal_ack(&s_journal, 2);
+
+    reboot();
+    TEST_ASSERT_EQUAL(3, press_journal_pending_count(&s_journal));
+    TEST_ASSERT_EQUAL(6, s_journal.next_seq);
+
+    press_journal_entry_t pending[8];
+    TEST_ASSERT_EQUAL(3, press_journal_read_pending(&s_journal, pending, 8));
+    TEST_ASSERT_EQUAL(3, pending[0].seq);
+    TEST_ASSERT_EQUAL(102, pending[0].day);
+    TEST_ASSERT_EQUAL(5, pending[2].seq);
+}
+
+static void test_wraps_and_levels_wear(void) {
+    reboot();
+    press_journal_entry_t e;
+    for (int i = 0; i < CAPACITY * 10; i++) {
+        TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, i, true, &e));
+        TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_ack(&s_journal, e.seq));
+    }
+    TEST_ASSERT_EQUAL(0, s_journal.dropped);
+
+    uint32_t min = s_flash.erases[0], max = s_flash.erases[0];
+    for (int s = 1; s < SECTOR_COUNT; s++) {
+        if (s_flash.erases[s] < min) min = s_flash.erases[s];
+        if (s_flash.erases[s] > max) max = s_flash.erases[s];
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(1, max - min);
+
+    reboot();
+    TEST_ASSERT_EQUAL(CAPACITY * 10 + 1, s_journal.next_seq);
+    TEST_ASSERT_EQUAL(0, press_journal_pending_count(&s_journal));
+}
+
+static void test_full_ring_drops_oldest(void) {
+    reboot();
+    press_journal_entry_t e;
+    for (int i = 0; i < CAPACITY + SLOTS / 2; i++) {
+        TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, i, true, &e));
+    }
+    TEST_ASSERT_EQUAL(SLOTS, s_journal.dropped);
+
+    press_journal_entry_t first;
+    TEST_ASSERT_EQUAL(1, press_journal_read_pending(&s_journal, &first, 1));
+    TEST_ASSERT_EQUAL(SLOTS + 1, first.seq);
+
+    reboot();
+    TEST_ASSERT_EQUAL(1, press_journal_read_pending(&s_journal, &first, 1));
+    TEST_ASSERT_EQUAL(SLOTS + 1, first.seq);
+    TEST_ASSERT_EQUAL(CAPACITY + SLOTS / 2 - SLOTS, press_journal_pending_count(&s_journal));
+}
+
+static void test_mount_reads_records_a_page_at_a_time(void) {
+    reboot();
+    press_journal_entry_t e;
+    for (int i = 0; i < CAPACITY - SLOTS / 2; i++) {
+        press_journal_append(&s_journal, 100 + i, true, &e);
+    }
+    press_journal_ack(&s_journal, SLOTS);
+
+    // Two passes, each reading every header and one page per sector
+    s_flash.reads = 0;
+    reboot();
+    TEST_ASSERT_EQUAL(CAPACITY - SLOTS / 2 - SLOTS, press_journal_pending_count(&s_journal));
+    TEST_ASSERT_TRUE(s_flash.reads <= 2 * SECTOR_COUNT * 2);
+}
+
+static void test_erase_forgets_everything(void) {
+    reboot();
+    press_journal_entry_t e;
+    for (int i = 0; i < SLOTS + 3; i++) {
+        press_journal_append(&s_journal, 100 + i, true, &e);
+    }
+    press_journal_ack(&s_journal, 2);
+
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_erase(&s_journal));
+    TEST_ASSERT_EQUAL(0, press_journal_pending_count(&s_journal));
+    TEST_ASSERT_EQUAL(1, s_journal.next_seq);
+    TEST_ASSERT_EQUAL(0, s_journal.acked_seq);
+
+    reboot();
+    TEST_ASSERT_EQUAL(0, press_journal_pending_count(&s_journal));
+    TEST_ASSERT_EQUAL(1, s_journal.next_seq);
+
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, 200, true, &e));
+    TEST_ASSERT_EQUAL(1, e.seq);
+    reboot();
+    TEST_ASSERT_EQUAL(1, press_journal_pending_count(&s_journal));
+}
+
+static void test_torn_record_is_skipped(void) {
+    reboot();
+    press_journal_entry_t e;
+    press_journal_append(&s_journal, 7, true, &e);
+
+    s_flash.budget = 6;  // cut the second record part way
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_ERR_IO, press_journal_append(&s_journal, 8, false, &e));
+
+    reboot();
+    TEST_ASSERT_EQUAL(1, s_journal.torn_records);
+    TEST_ASSERT_EQUAL(1, press_journal_pending_count(&s_journal));
+
+    TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_append(&s_journal, 9, true, &e));
+    press_journal_entry_t pending[4];
+    TEST_ASSERT_EQUAL(2, press_journal_read_pending(&s_journal, pending, 4));
+    TEST_ASSERT_EQUAL(1, pending[0].seq);
+    TEST_ASSERT_EQUAL(2, pending[1].seq);
+    TEST_ASSERT_EQUAL(9, pending[1].day);
+}
+
+// Random appends and acks with power cut at a random byte, then remount and
+// check nothing completed was lost, nothing was invented and order held.
+typedef struct {
+    int32_t day;
+    bool state;
+    bool written;  // append returned OK
+} model_record_t;
+
+// Raise for longer fuzzing runs, e.g. build_flags = -DFUZZ_ITERATIONS=1000000
+#ifndef FUZZ_ITERATIONS
+#define FUZZ_ITERATIONS 3000
+#endif
+#define FUZZ_MAX_SEQ    (CAPACITY * 8)
+
+static void test_fuzz_power_loss(void) {
+    static model_record_t model[FUZZ_MAX_SEQ + 2];
+
+    for (uint32_t seed = 1; seed <= FUZZ_ITERATIONS; seed++) {
+        flash_reset(seed * 2654435761u);
+        uint32_t rng = seed;
+        memset(model, 0, sizeof(model));
+        uint32_t acked_upto = 0;
+        uint32_t in_flight_ack = 0;
+        uint32_t in_flight_seq = 0;
+        uint32_t max_written = 0;
+
+        reboot();
+
+        // Several power cycles per seed
+        for (int cycle = 0; cycle < 4; cycle++) {
+            int ops = 1 + (int)(rng_next(&rng) % 60);
+            int cut_at = (int)(rng_next(&rng) % (ops + 1));
+            in_flight_ack = 0;
+            in_flight_seq = 0;
+
+            for (int op = 0; op < ops && !s_flash.dead; op++) {
+                if (op == cut_at) {
+                    s_flash.budget = (long)(rng_next(&rng) % 40);
+                }
+                if (s_journal.next_seq >= FUZZ_MAX_SEQ) break;
+
+                uint32_t r = rng_next(&rng) % 10;
+                if (r < 6 || press_journal_pending_count(&s_journal) == 0) {
+                    int32_t day = 19000 + (int32_t)(rng_next(&rng) % 400);
+                    bool state = rng_next(&rng) & 1;
+                    uint32_t seq = s_journal.next_seq;
+                    model[seq].day = day;
+                    model[seq].state = state;
+                    in_flight_seq = seq;
+                    press_journal_entry_t e;
+                    if (press_journal_append(&s_journal, day, state, &e) == PRESS_JOURNAL_OK) {
+                        model[seq].written = true;
+                        max_written = seq;
+                        in_flight_seq = 0;
+                    }
+                } else {
+                    press_journal_entry_t pending[4];
+                    int n = press_journal_read_pending(&s_journal, pending, 1 + (int)(rng_next(&rng) % 4));
+                    if (n == 0) continue;
+                    uint32_t target = pending[n - 1].seq;
+                    in_flight_ack = target;
+                    if (press_journal_ack(&s_journal, target) == PRESS_JOURNAL_OK) {
+                        acked_upto = target;
+                        in_flight_ack = 0;
+                    }
+                }
+            }
+
+            reboot();
+
+            // Nothing invented, strictly ordered, nothing delivered resurfaces
+            static press_journal_entry_t pending[CAPACITY];
+            int n = press_journal_read_pending(&s_journal, pending, CAPACITY);
+            TEST_ASSERT_EQUAL(n, (int)press_journal_pending_count(&s_journal));
+            uint32_t prev = 0;
+            for (int i = 0; i < n; i++) {
+                uint32_t seq = pending[i].seq;
+                TEST_ASSERT_TRUE_MESSAGE(seq > prev, "pending records out of order");
+                TEST_ASSERT_TRUE_MESSAGE(seq > acked_upto, "delivered record resurfaced");
+                TEST_ASSERT_TRUE_MESSAGE(model[seq].written || seq == in_flight_seq, "invented record");
+                TEST_ASSERT_EQUAL(model[seq].day, pending[i].day);
+                TEST_ASSERT_EQUAL(model[seq].state, pending[i].state);
+                prev = seq;
+            }
+
+            // Every completed, undelivered append is still there
+            int idx = 0;
+            uint32_t lower = acked_upto > in_flight_ack ? acked_upto : in_flight_ack;
+            for (uint32_t seq = acked_upto + 1; seq <= max_written; seq++) {
+                if (!model[seq].written) continue;
+                while (idx < n && pending[idx].seq < seq) idx++;
+                if (seq <= lower) continue;  // interrupted ack may have reached it
+                TEST_ASSERT_TRUE_MESSAGE(idx < n && pending[idx].seq == seq, "completed record lost");
+            }
+            TEST_ASSERT_TRUE(s_journal.next_seq > max_written);
+
+            // Re-sync the model with what the device now believes
+            if (n > 0 && pending[0].seq - 1 > acked_upto) acked_upto = pending[0].seq - 1;
+            if (n == 0 && max_written > acked_upto) acked_upto = max_written;
+            for (uint32_t seq = max_written + 1; seq < FUZZ_MAX_SEQ + 2; seq++) {
+                model[seq].written = false;
+            }
+            if (in_flight_seq && n > 0 && pending[n - 1].seq == in_flight_seq) {
+                model[in_flight_seq].written = true;
+                max_written = in_flight_seq;
+            }
+
+            // Keep the ring from overflowing so drops do not mask losses
+            while (press_journal_pending_count(&s_journal) > CAPACITY / 2) {
+                press_journal_entry_t oldest;
+                press_journal_read_pending(&s_journal, &oldest, 1);
+                TEST_ASSERT_EQUAL(PRESS_JOURNAL_OK, press_journal_ack(&s_journal, oldest.seq));
+                acked_upto = oldest.seq;
+            }
+        }
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_append_read_ack);
+    RUN_TEST(test_state_survives_remount);
+    RUN_TEST(test_wraps_and_levels_wear);
+    RUN_TEST(test_full_ring_drops_oldest);
+    RUN_TEST(test_mount_reads_records_a_page_at_a_time);
+    RUN_TEST(test_erase_forgets_everything);
+    RUN_TEST(test_torn_record_is_skipped);
+    RUN_TEST(test_fuzz_power_loss);
+    return UNITY_END();
+}
@@ -0,0 +1,192 @@
+#include <unity.h>
+
+#include <stdio.h>
+#include <time.h>
+
+#include "clock_util.h"
+#include "streak_engine.h"
+
+static uint32_t rng_next(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static int32_t day_of(int year, int month, int day) {
+    return days_from_civil(year, month, day);
+}
+
+// The old firmware's catch-up: one shift per elapsed day
+static void naive_advance(streak_t *s, int32_t today) {
+    while (s->day < today) {
+        s->bits = (uint8_t)(s->bits >> 1) & STREAK_MASK;
+        s->day++;
+    }
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_unknown_day_is_adopted(void) {
+    streak_t s;
+    streak_init(&s, STREAK_TODAY_BIT, STREAK_NO_DAY);
+    TEST_ASSERT_EQUAL_INT32(0, streak_advance(&s, day_of(2026, 3, 1)));
+    TEST_ASSERT_EQUAL_INT32(day_of(2026, 3, 1), s.day);
+    TEST_ASSERT_TRUE(streak_today(&s));
+}
+
+static void test_next_day_shifts_once(void) {
+    streak_t s;
+    streak_init(&s, 0x7F, day_of(2026, 3, 1));
+    TEST_ASSERT_EQUAL_INT32(1, streak_advance(&s, day_of(2026, 3, 2)));
+    TEST_ASSERT_EQUAL_HEX8(0x3F, s.bits);
+    TEST_ASSERT_FALSE(streak_today(&s));
+}
+
+static void test_same_or_earlier_day_is_noop(void) {
+    streak_t s;
+    streak_init(&s, 0x55, day_of(2026, 3, 2));
+    TEST_ASSERT_EQUAL_INT32(0, streak_advance(&s, day_of(2026, 3, 2)));
+    TEST_ASSERT_EQUAL_INT32(0, streak_advance(&s, day_of(2026, 3, 1)));
+    TEST_ASSERT_EQUAL_HEX8(0x55, s.bits);
+    TEST_ASSERT_EQUAL_INT32(day_of(2026, 3, 2), s.day);
+}
+
+static void test_year_boundary(void) {
+    streak_t s;
+    streak_init(&s, 0x70, day_of(2025, 12, 30));
+    TEST_ASSERT_EQUAL_INT32(3, streak_advance(&s, day_of(2026, 1, 2)));
+    TEST_ASSERT_EQUAL_HEX8(0x0E, s.bits);
+}
+
+static void test_leap_day(void) {
+    // 2028-02-28 -> 2028-03-01 is two days, not one
+    streak_t s;
+    streak_init(&s, STREAK_TODAY_BIT, day_of(2028, 2, 28));
+    TEST_ASSERT_EQUAL_INT32(2, streak_advance(&s, day_of(2028, 3, 1)));
+    TEST_ASSERT_EQUAL_HEX8(0x10, s.bits);
+
+    // Dec 31 of a leap year is day 365; the old +365 wrap got this wrong
+    streak_init(&s, STREAK_TODAY_BIT, day_of(2028, 12, 31));
+    TEST_ASSERT_EQUAL_INT32(1, streak_advance(&s, day_of(2029, 1, 1)));
+    TEST_ASSERT_EQUAL_HEX8(0x20, s.bits);
+}
+
+static void test_long_absence_clears_window(void) {
+    streak_t s;
+    streak_init(&s, 0x7F, day_of(2026, 3, 1));
+    TEST_ASSERT_EQUAL_INT32(7, streak_advance(&s, day_of(2026, 3, 8)));
+    TEST_ASSERT_EQUAL_HEX8(0, s.bits);
+
+    // Same day of the year, several years on
+    streak_init(&s, 0x7F, day_of(2023, 3, 1));
+    TEST_ASSERT_EQUAL_INT32(day_of(2026, 3, 1) - day_of(2023, 3, 1),
+                            streak_advance(&s, day_of(2026, 3, 1)));
+    TEST_ASSERT_EQUAL_HEX8(0, s.bits);
+}
+
+static void test_six_day_gap_keeps_oldest_bit(void) {
+    streak_t s;
+    streak_init(&s, STREAK_TODAY_BIT, day_of(2026, 3, 1));
+    streak_advance(&s, day_of(2026, 3, 7));
+    TEST_ASSERT_EQUAL_HEX8(0x01, s.bits);
+}
+
+static void test_toggle_today(void) {
+    streak_t s;
+    streak_init(&s, 0x01, day_of(2026, 3, 1));
+    TEST_ASSERT_TRUE(streak_toggle_today(&s));
+    TEST_ASSERT_EQUAL_HEX8(0x41, s.bits);
+    TEST_ASSERT_FALSE(streak_toggle_today(&s));
+    TEST_ASSERT_EQUAL_HEX8(0x01, s.bits);
+}
+
+static void test_day_from_yday(void) {
+    int32_t today = day_of(2026, 1, 3);
+    // Earlier this year
+    TEST_ASSERT_EQUAL_INT32(day_of(2026, 1, 1), streak_day_from_yday(0, today));
+    TEST_ASSERT_EQUAL_INT32(today, streak_day_from_yday(2, today));
+    // Later in the year than today means last year; 2025 is not a leap year
+    TEST_ASSERT_EQUAL_INT32(day_of(2025, 12, 31), streak_day_from_yday(364, today));
+    TEST_ASSERT_EQUAL_INT32(day_of(2025, 12, 30), streak_day_from_yday(363, today));
+
+    // After a leap year day 365 exists
+    today = day_of(2029, 1, 1);
+    TEST_ASSERT_EQUAL_INT32(day_of(2028, 12, 31), streak_day_from_yday(365, today));
+}
+
+static void test_matches_naive_catch_up(void) {
+    uint32_t rng = 12345;
+    for (int i = 0; i < 10000; i++) {
+        streak_t fast, slow;
+        uint8_t bits = (uint8_t)rng_next(&rng);
+        int32_t day = 18000 + (int32_t)(rng_next(&rng) % 4000);
+        int32_t gap = (int32_t)(rng_next(&rng) % 20);
+        streak_init(&fast, bits, day);
+        streak_init(&slow, bits, day);
+
+        TEST_ASSERT_EQUAL_INT32(gap, streak_advance(&fast, day + gap));
+        naive_advance(&slow, day + gap);
+        TEST_ASSERT_EQUAL_HEX8(slow.bits, fast.bits);
+        TEST_ASSERT_EQUAL_INT32(slow.day, fast.day);
+    }
+}
+
+// Raise for steadier numbers, e.g. build_flags = -DBENCH_ITERATIONS=10000000
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 200000
+#endif
+#define BENCH_MAX_GAP    (366 * 3)
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Catch-up cost for gaps of up to three years. Only reports; timings are
+// too noisy on shared hosts to assert on.
+static void test_bench_catch_up(void) {
+    uint32_t rng = 1;
+    volatile uint32_t sink = 0;
+
+    double start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        streak_t s;
+        streak_init(&s, (uint8_t)i, 20000);
+        streak_advance(&s, 20000 + (int32_t)(rng_next(&rng) % BENCH_MAX_GAP));
+        sink += s.bits;
+    }
+    double engine_ns = (now_ns() - start) / BENCH_ITERATIONS;
+
+    rng = 1;
+    start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        streak_t s;
+        streak_init(&s, (uint8_t)i, 20000);
+        naive_advance(&s, 20000 + (int32_t)(rng_next(&rng) % BENCH_MAX_GAP));
+        sink += s.bits;
+    }
+    double naive_ns = (now_ns() - start) / BENCH_ITERATIONS;
+
+    printf("catch-up over 0..%d days: engine %.1f ns/op, per-day loop %.1f ns/op\n",
+           BENCH_MAX_GAP - 1, engine_ns, naive_ns);
+    (void)sink;
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unknown_day_is_adopted);
+    RUN_TEST(test_next_day_shifts_once);
+    RUN_TEST(test_same_or_earlier_day_is_noop);
+    RUN_TEST(test_year_boundary);
+    RUN_TEST(test_leap_day);
+    RUN_TEST(test_long_absence_clears_window);
+    RUN_TEST(test_six_day_gap_keeps_oldest_bit);
+    RUN_TEST(test_toggle_today);
+    RUN_TEST(test_day_from_yday);
+    RUN_TEST(test_matches_naive_catch_up);
+    RUN_TEST(test_bench_catch_up);
+    return UNITY_END();
+}